@@ -0,0 +1,410 @@
+#include "lingeo3D.h"
+#include "tri_io.h"
+#include "triangle_soup.h"
+#include "sorted_cubes.h"
+#include "sweep_prune.h"
+#include "uniform_grid.h"
+#include "bvh.h"
+#include "size_buckets.h"
+#include "narrowphase.h"
+#include "tri_batch.h"
+#include "thread_pool.h"
+#include "scene_gen.h"
+#include "spatial_order.h"
+#include "dynamic_index.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <charconv>
+#include <random>
+
+using namespace lingeo3D;
+
+/*
+	              BENCHMARK
+	  times every stage of a search on fixed-seed scenes (scene_gen.h) of several sizes:
+	  text parsing, soup building, build and pair enumeration of every broadphase, every narrowphase on the same
+	  candidate pairs and the whole threaded search, in input order and in Morton order, then dynamic_index: its build and batches
+	  of moves, erases and inserts with their deltas; each stage runs once to warm up and then --reps times,
+	  the report gives median, percentiles and triangles per second as a table, csv or json (for tracking regressions)
+	  the set dynamic_index ends up with is checked against a full search of the same triangles, a mismatch fails the run
+
+*/
+
+typedef std::chrono::steady_clock bench_clock_t;
+
+struct stage_result_t{
+	std::string scene;
+	size_t count;
+	std::string stage;
+	size_t work;                        // candidate pairs or hits, 0 if the stage has none
+	std::vector<double> seconds;        // sorted
+};
+
+template<typename Fn>
+std::vector<double> measure(int reps, Fn &&fn){
+	fn();
+	std::vector<double> seconds;
+	for(int r = 0; r < reps; r++){
+		auto start = bench_clock_t::now();
+		fn();
+		seconds.push_back(std::chrono::duration<double>(bench_clock_t::now() - start).count());
+	}
+	std::sort(seconds.begin(), seconds.end());
+	return seconds;
+}
+
+double percentile(std::vector<double> const &sorted, double q){ // linear interpolation between closest ranks
+	double pos = q * (sorted.size() - 1);
+	size_t lo = (size_t)pos;
+	if(lo + 1 >= sorted.size())
+		return sorted.back();
+	return sorted[lo] + (pos - lo) * (sorted[lo + 1] - sorted[lo]);
+}
+
+std::string text_of(std::vector<float> const &coords){ // the text format, as gen_triangles writes it
+	std::string text = std::to_string(coords.size() / 9) + "\n";
+	char num[32];
+	for(size_t k = 0; k < coords.size(); k++){
+		char* end = std::to_chars(num, num + sizeof(num), coords[k]).ptr;
+		text.append(num, end);
+		text.push_back((k % 3 == 2) ? '\n' : ' ');
+	}
+	return text;
+}
+
+struct pair_counter_t{ // broadphase sink that only counts
+	size_t pairs = 0;
+	void operator()(int, int){ pairs++; }
+};
+
+template<typename Broad, typename... Args>
+void bench_broad(std::vector<stage_result_t> &results, stage_result_t const &base, const char* name, int reps, triangle_soup<float> const &soup, Args... args){
+	stage_result_t build = base, pairs = base;
+	build.stage = std::string("broad_") + name + "_build";
+	build.seconds = measure(reps, [&]{ Broad broad{soup, args...}; });
+
+	Broad broad{soup, args...};
+	pairs.stage = std::string("broad_") + name + "_pairs";
+	pairs.seconds = measure(reps, [&]{
+		pair_counter_t counter;
+		broad.for_each_pair(counter);
+		pairs.work = counter.pairs;
+	});
+	results.push_back(build);
+	results.push_back(pairs);
+}
+
+std::vector<char> search_all(triangle_soup<float> const &soup, narrow_t method){ // intersecting flags by a plain single threaded search
+	intersect_flags_t intersected{soup.size()};
+	pair_checker_t checker{soup, method, tri_batch_kernel(), intersected};
+	uniform_grid<float> grid{soup};
+	grid.for_each_pair(checker);
+	checker.flush();
+	std::vector<char> flags(soup.size());
+	for(size_t i = 0; i < soup.size(); i++)
+		flags[i] = intersected[i];
+	return flags;
+}
+
+void usage(){
+	std::cout << "Usage: bench_triangles [--sizes N,N,...] [--scenes uniform,clustered,wide,powerlaw,slivers,coplanar] [--reps R] [--seed S] [--threads N] [--sorted] [--format table|csv|json]\n";
+}
+
+std::vector<std::string> split_list(const char* list){
+	std::vector<std::string> items;
+	std::string item;
+	for(const char* p = list; ; p++){
+		if(*p == ',' || *p == '\0'){
+			if(!item.empty())
+				items.push_back(item);
+			item.clear();
+			if(*p == '\0')
+				break;
+		}
+		else
+			item.push_back(*p);
+	}
+	return items;
+}
+
+int main(int argc, char** argv){
+	std::vector<size_t> sizes{10000, 100000};
+	std::vector<scene_kind_t> scenes{SCENE_UNIFORM, SCENE_CLUSTERED, SCENE_WIDE, SCENE_COPLANAR};
+	int reps = 5;
+	uint64_t seed = 1;
+	unsigned threads = 0;
+	bool with_sorted = false;            // sorted_cubes goes quadratic on the wide scenes, only on request
+	std::string format = "table";
+
+	for(int i = 1; i < argc; i++){
+		if(std::strcmp(argv[i], "--sizes") == 0 && i + 1 < argc){
+			sizes.clear();
+			for(std::string const &item : split_list(argv[++i]))
+				sizes.push_back(std::strtoull(item.c_str(), nullptr, 10));
+		}
+		else if(std::strcmp(argv[i], "--scenes") == 0 && i + 1 < argc){
+			scenes.clear();
+			for(std::string const &item : split_list(argv[++i])){
+				scene_kind_t kind;
+				if(!scene_kind(item.c_str(), kind)){
+					usage();
+					return 0;
+				}
+				scenes.push_back(kind);
+			}
+		}
+		else if(std::strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+			reps = std::max(1, std::atoi(argv[++i]));
+		else if(std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = std::strtoull(argv[++i], nullptr, 10);
+		else if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = std::atoi(argv[++i]);
+		else if(std::strcmp(argv[i], "--sorted") == 0)
+			with_sorted = true;
+		else if(std::strcmp(argv[i], "--format") == 0 && i + 1 < argc && (std::strcmp(argv[i + 1], "table") == 0 || std::strcmp(argv[i + 1], "csv") == 0 || std::strcmp(argv[i + 1], "json") == 0))
+			format = argv[++i];
+		else{
+			usage();
+			return 0;
+		}
+	}
+
+	thread_pool_t pool{threads};
+	tri_batch_kernel_t kernel = tri_batch_kernel();
+	std::vector<stage_result_t> results;
+	int mismatches = 0;                  // scenes where dynamic_index disagrees with a full search
+
+	for(scene_kind_t kind : scenes)
+		for(size_t count : sizes){
+			scene_params_t params;                    // density and triangle size of tests/5.dat at every N
+			params.kind = kind;
+			params.count = count;
+			params.bounds = 100.0 * std::cbrt(count / 100000.0);
+			params.size = 1.0;
+			params.seed = seed;
+
+			std::vector<float> coords;
+			generate_scene(params, coords);
+			stage_result_t base{scene_names[kind], count, "", 0, {}};
+
+			// parsing and layout
+			std::string text = text_of(coords);
+			stage_result_t parse = base;
+			parse.stage = "parse_text";
+			parse.seconds = measure(reps, [&]{
+				std::vector<float> parsed;
+				parse_text_triangles(text.data(), text.size(), parsed);
+			});
+			results.push_back(parse);
+
+			stage_result_t soup_stage = base;
+			soup_stage.stage = "soup";
+			soup_stage.seconds = measure(reps, [&]{ triangle_soup<float> soup{coords.data(), count}; });
+			results.push_back(soup_stage);
+
+			triangle_soup<float> soup{coords.data(), count};
+
+			// broadphases, single threaded
+			bench_broad<sweep_prune<float>>(results, base, "sap", reps, soup);
+			bench_broad<uniform_grid<float>>(results, base, "grid", reps, soup, 0.0f);
+			bench_broad<bvh_tree<float>>(results, base, "bvh", reps, soup, 1u);
+			bench_broad<size_buckets<float>>(results, base, "buckets", reps, soup);
+			if(with_sorted){
+				stage_result_t sorted = base;
+				sorted.stage = "broad_sorted";
+				sorted.seconds = measure(reps, [&]{
+					sorted_cubes<float> s_cubes{soup};
+					size_t pairs = 0;
+					for(int i = 0; i < soup.size(); i++)
+						s_cubes.for_each_candidate(i, [&](int){ pairs++; return true; }, true);
+					sorted.work = pairs;
+				});
+				results.push_back(sorted);
+			}
+
+			// narrowphases on the same candidates (grouped by the first triangle, as the broadphases give them)
+			std::vector<std::pair<int, int>> candidates;
+			{
+				uniform_grid<float> grid{soup};
+				auto collect = [&](int i, int j){ candidates.push_back({i, j}); };
+				grid.for_each_pair(collect);
+			}
+			const char* narrow_names[] = {"narrow_angle", "narrow_planes", "narrow_batch", "narrow_exact"};
+			for(narrow_t method : {NARROW_ANGLE, NARROW_PLANES, NARROW_BATCH, NARROW_EXACT}){
+				stage_result_t narrow = base;
+				narrow.stage = narrow_names[method];
+				narrow.seconds = measure(reps, [&]{
+					size_t hits = 0;
+					if(method != NARROW_BATCH){
+						for(auto const &pair : candidates)
+							hits += soup.intersect(pair.first, pair.second, method);
+					}
+					else{
+						tri_batch_t batch;
+						for(size_t k = 0; k < candidates.size(); k++){
+							batch.add(soup, candidates[k].second);
+							if(batch.full() || k + 1 == candidates.size() || candidates[k + 1].first != candidates[k].first){
+								hits += __builtin_popcount(kernel(soup.triangle(candidates[k].first), batch));
+								batch.clear();
+							}
+						}
+					}
+					narrow.work = hits;
+				});
+				results.push_back(narrow);
+			}
+
+			// the plane test again, reading the per triangle side table (copy and build timed together)
+			triangle_soup<float> cached = soup;
+			cached.cache_planes();
+			stage_result_t cache = base;
+			cache.stage = "planes_cache";
+			cache.seconds = measure(reps, [&]{
+				triangle_soup<float> fresh = soup;
+				fresh.cache_planes();
+			});
+			results.push_back(cache);
+
+			stage_result_t planes_cached = base;
+			planes_cached.stage = "narrow_planes_cached";
+			planes_cached.seconds = measure(reps, [&]{
+				size_t hits = 0;
+				for(auto const &pair : candidates)
+					hits += cached.intersect(pair.first, pair.second, NARROW_PLANES);
+				planes_cached.work = hits;
+			});
+			results.push_back(planes_cached);
+
+			// the whole search as inter_sorted --broad grid --narrow batch runs it, then on the Morton ordered soup (--reorder morton)
+			auto search_grid_batch = [&](triangle_soup<float> const &searched, const char* stage){
+				stage_result_t search = base;
+				search.stage = stage;
+				search.seconds = measure(reps, [&]{
+					intersect_flags_t intersected{count};
+					std::vector<pair_checker_t> checkers;
+					for(unsigned w = 0; w < pool.size(); w++)
+						checkers.push_back({searched, NARROW_BATCH, kernel, intersected});
+					uniform_grid<float> grid{searched};
+					pool.run(grid.work_size(), [&](unsigned worker, size_t unit){
+						grid.for_each_pair(unit, unit + 1, checkers[worker]);
+						checkers[worker].flush();
+					});
+					size_t hits = 0;
+					for(size_t i = 0; i < count; i++)
+						hits += intersected[i];
+					search.work = hits;
+				});
+				results.push_back(search);
+			};
+			search_grid_batch(soup, "search_grid_batch");
+
+			triangle_soup<float> ordered = soup;
+			stage_result_t reorder = base;
+			reorder.stage = "reorder_morton";
+			reorder.seconds = measure(reps, [&]{
+				ordered = soup;
+				ordered.permute(spatial_order(ordered, REORDER_MORTON));
+			});
+			results.push_back(reorder);
+			search_grid_batch(ordered, "search_grid_batch_morton");
+
+			// dynamic_index: a third of every batch moves, a third is erased and inserted back elsewhere, deltas after each batch
+			const int dynamic_ops = 300;
+			stage_result_t dynamic_build = base;
+			dynamic_build.stage = "dynamic_build";
+			dynamic_build.seconds = measure(reps, [&]{ dynamic_index<float> index{soup, NARROW_PLANES}; });
+			results.push_back(dynamic_build);
+
+			dynamic_index<float> index{soup, NARROW_PLANES};
+			triangle_soup<float> moved = soup;                 // the same triangles, for the full search at the end
+			std::vector<char> member(count);                   // the set as the deltas tell it
+			for(int id : index.take_delta().entered)
+				member[id] = 1;
+			std::mt19937 random{(unsigned)seed};
+			std::uniform_int_distribution<int> pick{0, (int)count - 1};
+			std::uniform_real_distribution<float> shift{-2.0f * (float)params.size, 2.0f * (float)params.size};
+			auto moved_triangle = [&](int id){
+				point_t<float> offset{shift(random), shift(random), shift(random)};
+				triangle_t<float> tri = moved.triangle(id);
+				return triangle_t<float>{tri[0] + offset, tri[1] + offset, tri[2] + offset};
+			};
+
+			stage_result_t updates = base;
+			updates.stage = "dynamic_updates_300";
+			updates.seconds = measure(reps, [&]{
+				std::vector<int> erased;
+				for(int op = 0; op < dynamic_ops; op++){
+					if(op % 3 == 1){
+						int id = pick(random);
+						if(index.erase(id))
+							erased.push_back(id);
+						continue;
+					}
+					if(op % 3 == 2 && erased.empty())
+						continue;
+					int id = (op % 3 == 0) ? pick(random) : erased.back();
+					triangle_t<float> tri = moved_triangle(id);
+					if(op % 3 == 0 ? index.update(id, tri) : index.insert(id, tri))
+						moved.set(id, tri);
+					if(op % 3 == 2)
+						erased.pop_back();
+				}
+				for(int id : erased)                            // the rest goes back where it was
+					index.insert(id, moved.triangle(id));
+				index_delta_t delta = index.take_delta();
+				for(int id : delta.entered)
+					member[id] = 1;
+				for(int id : delta.left)
+					member[id] = 0;
+				updates.work = delta.entered.size() + delta.left.size();
+			});
+			results.push_back(updates);
+
+			std::vector<char> expected = search_all(moved, NARROW_PLANES);
+			for(size_t id = 0; id < count; id++)
+				if(member[id] != expected[id] || index.intersected(id) != (bool)expected[id]){
+					std::fprintf(stderr, "dynamic_index: triangle %zu of %s/%zu is %s by the deltas, %s by a full search\n", id, scene_names[kind], count,
+					             member[id] ? "in" : "out", expected[id] ? "in" : "out");
+					mismatches++;
+					break;
+				}
+		}
+
+	// report
+	if(format == "json"){
+		std::printf("{\"seed\": %llu, \"reps\": %d, \"threads\": %u, \"kernel\": \"%s\", \"results\": [", (unsigned long long)seed, reps, pool.size(), tri_batch_kernel_name(kernel));
+		for(size_t r = 0; r < results.size(); r++){
+			stage_result_t const &res = results[r];
+			double median = percentile(res.seconds, 0.5);
+			std::printf("%s\n  {\"scene\": \"%s\", \"n\": %zu, \"stage\": \"%s\", \"work\": %zu, \"median_ms\": %.4f, \"p10_ms\": %.4f, \"p90_ms\": %.4f, \"min_ms\": %.4f, \"max_ms\": %.4f, \"tri_per_s\": %.0f}",
+			            (r == 0) ? "" : ",", res.scene.c_str(), res.count, res.stage.c_str(), res.work, median * 1e3, percentile(res.seconds, 0.1) * 1e3,
+			            percentile(res.seconds, 0.9) * 1e3, res.seconds.front() * 1e3, res.seconds.back() * 1e3, res.count / median);
+		}
+		std::printf("\n]}\n");
+	}
+	else if(format == "csv"){
+		std::printf("scene,n,stage,work,median_ms,p10_ms,p90_ms,min_ms,max_ms,tri_per_s\n");
+		for(stage_result_t const &res : results){
+			double median = percentile(res.seconds, 0.5);
+			std::printf("%s,%zu,%s,%zu,%.4f,%.4f,%.4f,%.4f,%.4f,%.0f\n", res.scene.c_str(), res.count, res.stage.c_str(), res.work, median * 1e3,
+			            percentile(res.seconds, 0.1) * 1e3, percentile(res.seconds, 0.9) * 1e3, res.seconds.front() * 1e3, res.seconds.back() * 1e3, res.count / median);
+		}
+	}
+	else{
+		std::printf("seed %llu, %d reps, %u threads, %s kernel\n", (unsigned long long)seed, reps, pool.size(), tri_batch_kernel_name(kernel));
+		std::printf("%-10s %9s %-22s %11s %11s %11s %11s %14s\n", "scene", "n", "stage", "work", "median ms", "p10 ms", "p90 ms", "tri/s");
+		for(stage_result_t const &res : results){
+			double median = percentile(res.seconds, 0.5);
+			std::printf("%-10s %9zu %-22s %11zu %11.3f %11.3f %11.3f %14.0f\n", res.scene.c_str(), res.count, res.stage.c_str(), res.work, median * 1e3,
+			            percentile(res.seconds, 0.1) * 1e3, percentile(res.seconds, 0.9) * 1e3, res.count / median);
+		}
+	}
+
+	return (mismatches == 0) ? 0 : 1;
+}
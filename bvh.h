@@ -0,0 +1,387 @@
+#pragma once
+#include "lingeo3D.h"
+#include "triangle_soup.h"
+#include "sorted_cubes.h"
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+
+namespace lingeo3D{
+
+/*
+	              BOUNDING VOLUME HIERARCHY
+	  binary tree over the tight triangle boxes, built top-down with binned SAH (surface area heuristic),
+	  big subtrees are built concurrently
+	  candidate pairs come from traversing the tree against itself: self(node) = self(left) + self(right) + cross(left, right),
+	  cross(a, b) only descends while the boxes of a and b overlap, so every pair is reported once and dense and sparse
+	  regions of the scene cost what they hold, whatever the size and spread of the triangles
+	  the top of the traversal is unrolled at build time into independent tasks (the work units)
+
+*/
+
+template<typename T>
+	class bvh_cross;
+
+template<typename T>
+	class bvh_tree{
+
+		friend class bvh_cross<T>;
+
+		struct node_t{
+			cube_t<T> box;
+			int child;               // interior: left child, the right one is child + 1; leaf: first entry in prims_
+			int count;               // leaf: number of triangles, 0 for interior nodes
+		};
+
+		struct task_t{               // self(a) if a == b, cross(a, b) otherwise
+			int a, b;
+		};
+
+		std::vector<cube_t<T>> cubes_;     // tight boxes by triangle index
+		std::vector<int> prims_;           // triangle indices, every leaf owns a range of them
+		std::vector<node_t> nodes_;        // nodes_[0] is the root
+		std::atomic<int> node_count_{0};
+		std::vector<task_t> tasks_;
+
+		static const int leaf_size_ = 4;        // split nodes bigger than this when SAH finds it worth it
+		static const int max_leaf_size_ = 16;   // always split nodes bigger than this
+		static const int bins_ = 16;
+		static const int parallel_size_ = 1 << 16;
+		static const int target_tasks_ = 1024;
+
+		static cube_t<T> merge(cube_t<T> const &a, cube_t<T> const &b){
+			return cube_t<T>{std::min(a.min_x(), b.min_x()), std::min(a.min_y(), b.min_y()), std::min(a.min_z(), b.min_z()),
+			                 std::max(a.max_x(), b.max_x()), std::max(a.max_y(), b.max_y()), std::max(a.max_z(), b.max_z())};
+		}
+
+		static T area(cube_t<T> const &box){
+			T dx = box.max_x() - box.min_x(), dy = box.max_y() - box.min_y(), dz = box.max_z() - box.min_z();
+			return dx * dy + dy * dz + dz * dx;
+		}
+
+		static T centroid(cube_t<T> const &box, int axis){
+			if(axis == 0) return (box.min_x() + box.max_x()) * 0.5;
+			if(axis == 1) return (box.min_y() + box.max_y()) * 0.5;
+			return (box.min_z() + box.max_z()) * 0.5;
+		}
+
+		void build(int node, int begin, int end, int par_depth){
+			cube_t<T> box = cubes_[prims_[begin]];
+			T cmin[3], cmax[3];
+			for(int a = 0; a < 3; a++)
+				cmin[a] = cmax[a] = centroid(box, a);
+			for(int p = begin + 1; p < end; p++){
+				cube_t<T> const &c = cubes_[prims_[p]];
+				box = merge(box, c);
+				for(int a = 0; a < 3; a++){
+					cmin[a] = std::min(cmin[a], centroid(c, a));
+					cmax[a] = std::max(cmax[a], centroid(c, a));
+				}
+			}
+			nodes_[node].box = box;
+
+			int count = end - begin;
+			int axis = 0;
+			for(int a = 1; a < 3; a++)
+				if(cmax[a] - cmin[a] > cmax[axis] - cmin[axis])
+					axis = a;
+			T extent = cmax[axis] - cmin[axis];
+
+			if(count <= leaf_size_ || (!(extent > 0.0) && count <= max_leaf_size_)){
+				make_leaf(node, begin, end);
+				return;
+			}
+
+			int mid = begin + count / 2;
+			if(extent > 0.0){
+				// binned SAH: cost of every split between bins, compared with the cost of keeping a leaf
+				int bin_count[bins_] = {};
+				cube_t<T> bin_box[bins_];
+				T scale = bins_ / extent;
+				auto bin_of = [&](int p) -> int {
+					int b = (int)((centroid(cubes_[prims_[p]], axis) - cmin[axis]) * scale);
+					return std::min(std::max(b, 0), bins_ - 1);
+				};
+				for(int p = begin; p < end; p++){
+					int b = bin_of(p);
+					bin_box[b] = (bin_count[b] == 0) ? cubes_[prims_[p]] : merge(bin_box[b], cubes_[prims_[p]]);
+					bin_count[b]++;
+				}
+
+				T right_area[bins_];
+				int right_count[bins_];
+				cube_t<T> acc;
+				int n = 0;
+				for(int b = bins_ - 1; b > 0; b--){
+					if(bin_count[b] != 0){
+						acc = (n == 0) ? bin_box[b] : merge(acc, bin_box[b]);
+						n += bin_count[b];
+					}
+					right_area[b] = (n == 0) ? 0.0 : area(acc);
+					right_count[b] = n;
+				}
+
+				T best_cost = 0.0;
+				int best_split = -1;
+				n = 0;
+				for(int b = 0; b < bins_ - 1; b++){
+					if(bin_count[b] != 0){
+						acc = (n == 0) ? bin_box[b] : merge(acc, bin_box[b]);
+						n += bin_count[b];
+					}
+					if(n == 0 || right_count[b + 1] == 0)
+						continue;
+					T cost = area(acc) * n + right_area[b + 1] * right_count[b + 1];
+					if(best_split < 0 || cost < best_cost){
+						best_cost = cost;
+						best_split = b + 1;
+					}
+				}
+
+				if(best_split > 0){
+					if(count <= max_leaf_size_ && best_cost >= area(box) * count){
+						make_leaf(node, begin, end);
+						return;
+					}
+					mid = std::partition(prims_.begin() + begin, prims_.begin() + end, [&](int prim) -> bool {
+						int b = (int)((centroid(cubes_[prim], axis) - cmin[axis]) * scale);
+						return std::min(std::max(b, 0), bins_ - 1) < best_split;
+					}) - prims_.begin();
+				}
+			}
+			if(mid == begin || mid == end){ // no useful bin border: median split keeps the tree logarithmic
+				mid = begin + count / 2;
+				std::nth_element(prims_.begin() + begin, prims_.begin() + mid, prims_.begin() + end, [&](int p1, int p2) -> bool {
+					return centroid(cubes_[p1], axis) < centroid(cubes_[p2], axis);
+				});
+			}
+
+			int left = node_count_.fetch_add(2);
+			nodes_[node].child = left;
+			nodes_[node].count = 0;
+			if(par_depth > 0 && count > parallel_size_){
+				auto left_done = std::async(std::launch::async, [=]{ build(left, begin, mid, par_depth - 1); });
+				build(left + 1, mid, end, par_depth - 1);
+				left_done.get();
+			}
+			else{
+				build(left, begin, mid, 0);
+				build(left + 1, mid, end, 0);
+			}
+		}
+
+		void make_leaf(int node, int begin, int end){
+			nodes_[node].child = begin;
+			nodes_[node].count = end - begin;
+		}
+
+		void split_tasks(){ // breadth first unrolling of self(root) until there are enough independent tasks
+			std::vector<task_t> open{{0, 0}};
+			while(!open.empty() && tasks_.size() + open.size() < target_tasks_){
+				std::vector<task_t> next;
+				for(task_t const &t : open){
+					node_t const &a = nodes_[t.a];
+					node_t const &b = nodes_[t.b];
+					if(t.a == t.b){
+						if(a.count != 0){
+							tasks_.push_back(t);
+							continue;
+						}
+						next.push_back({a.child, a.child});
+						next.push_back({a.child + 1, a.child + 1});
+						next.push_back({a.child, a.child + 1});
+						continue;
+					}
+					if(!a.box.interfare(b.box))
+						continue;
+					if(a.count != 0 && b.count != 0)
+						tasks_.push_back(t);
+					else if(b.count != 0 || (a.count == 0 && area(a.box) >= area(b.box))){
+						next.push_back({a.child, t.b});
+						next.push_back({a.child + 1, t.b});
+					}
+					else{
+						next.push_back({t.a, b.child});
+						next.push_back({t.a, b.child + 1});
+					}
+				}
+				open.swap(next);
+			}
+			tasks_.insert(tasks_.end(), open.begin(), open.end());
+		}
+
+		template<typename Fn>
+		void self(int n, Fn &fn) const{
+			node_t const &node = nodes_[n];
+			if(node.count != 0){
+				for(int p = node.child; p < node.child + node.count; p++)
+					for(int q = p + 1; q < node.child + node.count; q++)
+						if(cubes_[prims_[p]].interfare(cubes_[prims_[q]]))
+							fn(prims_[p], prims_[q]);
+				return;
+			}
+			self(node.child, fn);
+			self(node.child + 1, fn);
+			cross(*this, node.child, *this, node.child + 1, fn);
+		}
+
+		template<typename Fn>
+		static void cross(bvh_tree<T> const &ta, int a, bvh_tree<T> const &tb, int b, Fn &fn){ // node a of ta against node b of tb, the trees may be the same
+			node_t const &na = ta.nodes_[a];
+			node_t const &nb = tb.nodes_[b];
+			if(!na.box.interfare(nb.box))
+				return;
+			if(na.count != 0 && nb.count != 0){
+				for(int p = na.child; p < na.child + na.count; p++){
+					cube_t<T> const &cube = ta.cubes_[ta.prims_[p]];
+					if(!cube.interfare(nb.box))
+						continue;
+					for(int q = nb.child; q < nb.child + nb.count; q++)
+						if(cube.interfare(tb.cubes_[tb.prims_[q]]))
+							fn(ta.prims_[p], tb.prims_[q]);
+				}
+				return;
+			}
+			if(nb.count != 0 || (na.count == 0 && area(na.box) >= area(nb.box))){ // descend the bigger interior node
+				cross(ta, na.child, tb, b, fn);
+				cross(ta, na.child + 1, tb, b, fn);
+			}
+			else{
+				cross(ta, a, tb, nb.child, fn);
+				cross(ta, a, tb, nb.child + 1, fn);
+			}
+		}
+
+	public:
+
+		bvh_tree(triangle_soup<T> const &soup, unsigned threads = 0){ // threads 0 - as many as the hardware has
+			int n = soup.size();
+			cubes_.reserve(n);
+			prims_.resize(n);
+			for(int i = 0; i < n; i++){
+				cubes_.insert(cubes_.end(), {soup, i});
+				prims_[i] = i;
+			}
+			if(n == 0)
+				return;
+
+			if(threads == 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+			int par_depth = 0;
+			while((1u << par_depth) < threads)
+				par_depth++;
+
+			nodes_.resize(2 * n);
+			node_count_ = 1;
+			build(0, 0, n, par_depth);
+			nodes_.resize(node_count_);
+			split_tasks();
+		}
+
+		size_t size() const{ return cubes_.size(); }
+		size_t node_count() const{ return nodes_.size(); }
+
+		size_t work_size() const{ return tasks_.size(); }
+
+		template<typename Fn>
+		void for_each_pair(size_t begin, size_t end, Fn &fn) const{ // fn(i, j) for every candidate pair owned by tasks [begin, end), pairs sharing i come in a row
+			for(size_t t = begin; t < end; t++){
+				if(tasks_[t].a == tasks_[t].b)
+					self(tasks_[t].a, fn);
+				else
+					cross(*this, tasks_[t].a, *this, tasks_[t].b, fn);
+			}
+		}
+
+		template<typename Fn>
+		void for_each_pair(Fn &fn) const{
+			for_each_pair(0, work_size(), fn);
+		}
+
+		template<typename Fn>
+		void for_each_overlap(cube_t<T> const &cube, Fn &&fn) const{ // fn(i) for every triangle whose box interferes with cube, only reads the tree
+			if(nodes_.empty())
+				return;
+			std::vector<int> stack{0};
+			while(!stack.empty()){
+				node_t const &node = nodes_[stack.back()];
+				stack.pop_back();
+				if(!cube.interfare(node.box))
+					continue;
+				if(node.count == 0){
+					stack.push_back(node.child);
+					stack.push_back(node.child + 1);
+					continue;
+				}
+				for(int p = node.child; p < node.child + node.count; p++)
+					if(cube.interfare(cubes_[prims_[p]]))
+						fn(prims_[p]);
+			}
+		}
+	};
+
+
+/*
+	              BVH CROSS
+	  candidate pairs between two trees: the traversal cross(a, b) of one tree against itself run from the two roots,
+	  its top unrolled into work units the same way; pairs are (triangle of a, triangle of b), those sharing
+	  the first come in a row
+
+*/
+
+template<typename T>
+	class bvh_cross{
+
+		typedef typename bvh_tree<T>::task_t task_t;
+		typedef typename bvh_tree<T>::node_t node_t;
+
+		bvh_tree<T> const &a_;
+		bvh_tree<T> const &b_;
+		std::vector<task_t> tasks_;
+
+	public:
+
+		bvh_cross(bvh_tree<T> const &a, bvh_tree<T> const &b): a_(a), b_(b){
+			if(a_.nodes_.empty() || b_.nodes_.empty())
+				return;
+			std::vector<task_t> open{{0, 0}};
+			while(!open.empty() && tasks_.size() + open.size() < bvh_tree<T>::target_tasks_){
+				std::vector<task_t> next;
+				for(task_t const &t : open){
+					node_t const &na = a_.nodes_[t.a];
+					node_t const &nb = b_.nodes_[t.b];
+					if(!na.box.interfare(nb.box))
+						continue;
+					if(na.count != 0 && nb.count != 0)
+						tasks_.push_back(t);
+					else if(nb.count != 0 || (na.count == 0 && bvh_tree<T>::area(na.box) >= bvh_tree<T>::area(nb.box))){
+						next.push_back({na.child, t.b});
+						next.push_back({na.child + 1, t.b});
+					}
+					else{
+						next.push_back({t.a, nb.child});
+						next.push_back({t.a, nb.child + 1});
+					}
+				}
+				open.swap(next);
+			}
+			tasks_.insert(tasks_.end(), open.begin(), open.end());
+		}
+
+		size_t work_size() const{ return tasks_.size(); }
+
+		template<typename Fn>
+		void for_each_pair(size_t begin, size_t end, Fn &fn) const{ // fn(i, j) for every candidate pair owned by tasks [begin, end), i in a, j in b
+			for(size_t t = begin; t < end; t++)
+				bvh_tree<T>::cross(a_, tasks_[t].a, b_, tasks_[t].b, fn);
+		}
+
+		template<typename Fn>
+		void for_each_pair(Fn &fn) const{
+			for_each_pair(0, work_size(), fn);
+		}
+	};
+
+};
@@ -0,0 +1,254 @@
+#pragma once
+#include "lingeo3D.h"
+#include "triangle_soup.h"
+#include "sorted_cubes.h"
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace lingeo3D{
+
+/*
+	              DYNAMIC INDEX
+	  persistent version of the padded cubes for scenes that change a little at a time:
+	  triangles are kept by id in size classes (powers of two of their largest extent, see size_buckets.h)
+	  and every class is a hashed grid whose cell is the class padding, a triangle is stored once, in the cell of its lower corner,
+	  so partners of a box in a class are in the few cells from its lower corner minus the padding to its upper corner
+	  (a class with fewer triangles than such cells is just scanned); insert, erase and update cost the pairs
+	  of the changed triangle and a few cells per class, whatever the size of the scene
+	  every triangle keeps the list of triangles it intersects, it is in the intersecting set while the list is not empty
+	  ids whose membership may have changed are remembered until take_delta() reports the ones that entered and left
+	  the set since the previous call
+
+*/
+
+	struct index_delta_t{
+		std::vector<int> entered;     // ids intersecting now that did not at the previous take_delta()
+		std::vector<int> left;        // ids that intersected at the previous take_delta() and do not now (or were erased)
+	};
+
+template<typename T>
+	class dynamic_index{
+
+		struct cell_key_t{
+			int64_t x, y, z;
+			bool operator==(cell_key_t const &other) const{ return x == other.x && y == other.y && z == other.z; }
+		};
+
+		struct cell_hash_t{
+			size_t operator()(cell_key_t const &key) const{ // splitmix64 finalizer over the packed coordinates
+				uint64_t id = (uint64_t)key.x * 0x9e3779b97f4a7c15ULL ^ (uint64_t)key.y * 0xc2b2ae3d27d4eb4fULL ^ (uint64_t)key.z;
+				id ^= id >> 30; id *= 0xbf58476d1ce4e5b9ULL;
+				id ^= id >> 27; id *= 0x94d049bb133111ebULL;
+				return id ^ (id >> 31);
+			}
+		};
+
+		struct bucket_t{
+			T cell;                                  // cell size, not less than any box the bucket holds
+			size_t size = 0;
+			std::unordered_map<cell_key_t, std::vector<int>, cell_hash_t> cells;
+		};
+
+		narrow_t method_;
+		std::map<int, bucket_t> buckets_;            // by size class
+
+		std::vector<triangle_t<T>> triangles_;       // by id
+		std::vector<cube_t<T>> cubes_;               // tight boxes by id
+		std::vector<int> classes_;                   // size class by id
+		std::vector<bool> alive_;
+		std::vector<std::vector<int>> partners_;     // ids every triangle intersects
+		std::vector<bool> reported_;                 // membership at the previous take_delta()
+		std::vector<int> touched_;                   // ids whose membership may have changed since then
+		std::vector<bool> is_touched_;
+		size_t size_ = 0;
+
+		static constexpr int64_t max_coord_ = (int64_t)1 << 40;
+
+		static cube_t<T> bounds(triangle_t<T> const &tri){
+			return cube_t<T>{std::min({tri[0].x_, tri[1].x_, tri[2].x_}), std::min({tri[0].y_, tri[1].y_, tri[2].y_}), std::min({tri[0].z_, tri[1].z_, tri[2].z_}),
+			                 std::max({tri[0].x_, tri[1].x_, tri[2].x_}), std::max({tri[0].y_, tri[1].y_, tri[2].y_}), std::max({tri[0].z_, tri[1].z_, tri[2].z_})};
+		}
+
+		static int size_class(cube_t<T> const &cube){
+			int exp = 0;
+			std::frexp(std::max<T>({cube.max_x() - cube.min_x(), cube.max_y() - cube.min_y(), cube.max_z() - cube.min_z(), flt_tolerance}), &exp);
+			return exp;
+		}
+
+		static int64_t cell_coord(T val, T cell){
+			T c = std::floor(val / cell);
+			if(!(c > -max_coord_))                     // NaN lands in the lowest cell too
+				return -max_coord_;
+			return (c >= max_coord_) ? max_coord_ : (int64_t)c;
+		}
+
+		static cell_key_t cell_of(cube_t<T> const &cube, T cell){
+			return {cell_coord(cube.min_x(), cell), cell_coord(cube.min_y(), cell), cell_coord(cube.min_z(), cell)};
+		}
+
+		bool narrow(int id, int other) const{
+			if(method_ == NARROW_ANGLE)
+				return triangles_[id].intersect(triangles_[other]);
+			if(method_ == NARROW_EXACT)
+				return triangles_[id].intersect_exact(triangles_[other]);
+			return triangles_[id].intersect_by_planes(triangles_[other]);
+		}
+
+		void touch(int id){
+			if(!is_touched_[id]){
+				is_touched_[id] = true;
+				touched_.push_back(id);
+			}
+		}
+
+		void grow(int id){
+			if(id < alive_.size())
+				return;
+			size_t n = id + 1;
+			triangles_.resize(n);
+			cubes_.resize(n);
+			classes_.resize(n);
+			alive_.resize(n, false);
+			partners_.resize(n);
+			reported_.resize(n, false);
+			is_touched_.resize(n, false);
+		}
+
+		void link(int id, int other){
+			if(partners_[id].empty()) touch(id);
+			if(partners_[other].empty()) touch(other);
+			partners_[id].push_back(other);
+			partners_[other].push_back(id);
+		}
+
+		void unlink_all(int id){
+			for(int other : partners_[id]){
+				std::vector<int> &list = partners_[other];
+				auto pos = std::find(list.begin(), list.end(), id);
+				*pos = list.back();
+				list.pop_back();
+				if(list.empty())
+					touch(other);
+			}
+			if(!partners_[id].empty())
+				touch(id);
+			partners_[id].clear();
+		}
+
+	public:
+
+		dynamic_index(narrow_t method = NARROW_ANGLE): method_(method == NARROW_BATCH ? NARROW_PLANES : method){
+
+		}
+
+		dynamic_index(triangle_soup<T> const &soup, narrow_t method = NARROW_ANGLE): dynamic_index(method){ // ids are the soup indices
+			grow((int)soup.size() - 1);
+			for(int i = 0; i < soup.size(); i++)
+				insert(i, soup.triangle(i));
+		}
+
+		size_t size() const{ return size_; }
+		bool contains(int id) const{ return id >= 0 && id < alive_.size() && alive_[id]; }
+		bool intersected(int id) const{ return contains(id) && !partners_[id].empty(); }
+		std::vector<int> const &partners(int id) const{ return partners_[id]; }
+
+		template<typename Fn>
+		void for_each_candidate(cube_t<T> const &cube, Fn &&fn) const{ // fn(id) for every stored triangle whose box interferes with cube
+			for(auto const &level : buckets_){
+				bucket_t const &bucket = level.second;
+				cube_t<T> reach{cube.min_x() - bucket.cell - flt_tolerance, cube.min_y() - bucket.cell - flt_tolerance, cube.min_z() - bucket.cell - flt_tolerance,
+				                cube.max_x() + flt_tolerance, cube.max_y() + flt_tolerance, cube.max_z() + flt_tolerance};
+				cell_key_t lo = cell_of(reach, bucket.cell);
+				cell_key_t hi{cell_coord(reach.max_x(), bucket.cell), cell_coord(reach.max_y(), bucket.cell), cell_coord(reach.max_z(), bucket.cell)};
+				double cells = (double)(hi.x - lo.x + 1) * (hi.y - lo.y + 1) * (hi.z - lo.z + 1);
+
+				auto visit = [&](std::vector<int> const &ids){
+					for(int id : ids)
+						if(cube.interfare(cubes_[id]))
+							fn(id);
+				};
+				if(cells > bucket.size){               // box much bigger than the class: cheaper to scan it
+					for(auto const &cell : bucket.cells)
+						visit(cell.second);
+					continue;
+				}
+				for(int64_t cx = lo.x; cx <= hi.x; cx++)
+					for(int64_t cy = lo.y; cy <= hi.y; cy++)
+						for(int64_t cz = lo.z; cz <= hi.z; cz++){
+							auto pos = bucket.cells.find({cx, cy, cz});
+							if(pos != bucket.cells.end())
+								visit(pos->second);
+						}
+			}
+		}
+
+		bool insert(int id, triangle_t<T> const &tri){ // false if id is taken already
+			if(id < 0 || contains(id))
+				return false;
+			grow(id);
+			triangles_[id] = tri;
+			cubes_[id] = bounds(tri);
+			classes_[id] = size_class(cubes_[id]);
+
+			for_each_candidate(cubes_[id], [&](int other){
+				if(narrow(id, other))
+					link(id, other);
+			});
+
+			bucket_t &bucket = buckets_[classes_[id]];
+			bucket.cell = std::ldexp((T)1.0, classes_[id]);
+			bucket.cells[cell_of(cubes_[id], bucket.cell)].push_back(id);
+			bucket.size++;
+			alive_[id] = true;
+			size_++;
+			return true;
+		}
+
+		bool erase(int id){ // false if there is no such id
+			if(!contains(id))
+				return false;
+			unlink_all(id);
+			auto bucket = buckets_.find(classes_[id]);
+			auto cell = bucket->second.cells.find(cell_of(cubes_[id], bucket->second.cell));
+			*std::find(cell->second.begin(), cell->second.end(), id) = cell->second.back();
+			cell->second.pop_back();
+			if(cell->second.empty())
+				bucket->second.cells.erase(cell);
+			if(--bucket->second.size == 0)
+				buckets_.erase(bucket);
+			alive_[id] = false;
+			size_--;
+			touch(id);
+			return true;
+		}
+
+		bool update(int id, triangle_t<T> const &tri){ // moves the triangle, false if there is no such id
+			if(!erase(id))
+				return false;
+			return insert(id, tri);
+		}
+
+		index_delta_t take_delta(){ // membership changes since the previous call, cost is the number of touched ids
+			index_delta_t delta;
+			for(int id : touched_){
+				bool now = intersected(id);
+				if(now && !reported_[id])
+					delta.entered.push_back(id);
+				else if(!now && reported_[id])
+					delta.left.push_back(id);
+				reported_[id] = now;
+				is_touched_[id] = false;
+			}
+			touched_.clear();
+			std::sort(delta.entered.begin(), delta.entered.end());
+			std::sort(delta.left.begin(), delta.left.end());
+			return delta;
+		}
+	};
+
+};
@@ -0,0 +1,218 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <unistd.h>
+
+namespace lingeo3D{
+
+/*
+	              EXTERNAL SORTER
+	  sorts more records than fit in memory: push() fills a buffer of mem_bytes, a full buffer is sorted and
+	  written out as a run (an unlinked temporary file in TMPDIR, gone with the process), finish() merges the runs
+	  fan-in at a time until one k-way merge is left and next() streams the records out of it in order
+	  when everything fits in the buffer nothing touches the disk; records are written raw, so they must be
+	  trivially copyable; Less has to be a strict weak order (no NaN keys)
+
+*/
+
+template<typename Rec, typename Less = std::less<Rec>>
+	class external_sorter{
+
+		static_assert(std::is_trivially_copyable<Rec>::value, "records are written to disk as bytes");
+
+		class run_reader_t{ // buffered sequential read of one run
+
+			FILE* file_ = nullptr;
+			std::vector<Rec> buf_;
+			size_t pos_ = 0, len_ = 0;
+
+		public:
+			run_reader_t(FILE* file, size_t records): file_(file), buf_(records){
+				std::rewind(file_);
+			}
+
+			bool next(Rec &rec){
+				if(pos_ == len_){
+					len_ = std::fread(buf_.data(), sizeof(Rec), buf_.size(), file_);
+					pos_ = 0;
+					if(len_ == 0)
+						return false;
+				}
+				rec = buf_[pos_++];
+				return true;
+			}
+		};
+
+		Less less_;
+		size_t buffer_cap_;                  // records sorted in memory at a time
+		size_t read_bytes_;                  // memory for the readers of one merge
+		std::vector<Rec> buffer_;
+		std::vector<FILE*> runs_;
+		size_t count_ = 0;
+		bool failed_ = false;
+
+		std::vector<run_reader_t> readers_;  // the last merge, read by next()
+		std::vector<std::pair<Rec, size_t>> heap_;
+		size_t mem_pos_ = 0;                 // no runs: next() reads the sorted buffer
+
+		bool heap_less(std::pair<Rec, size_t> const &a, std::pair<Rec, size_t> const &b) const{ // max-heap helpers want the reverse
+			return less_(b.first, a.first);
+		}
+
+		static FILE* temp_file(){
+			const char* dir = std::getenv("TMPDIR");
+			std::string path = std::string((dir != nullptr && *dir != '\0') ? dir : "/tmp") + "/tri_runXXXXXX";
+			int fd = mkstemp(&path[0]);
+			if(fd < 0)
+				return nullptr;
+			unlink(path.c_str());
+			FILE* file = fdopen(fd, "w+b");
+			if(file == nullptr)
+				close(fd);
+			return file;
+		}
+
+		bool spill(){
+			std::sort(buffer_.begin(), buffer_.end(), less_);
+			FILE* run = temp_file();
+			if(run == nullptr)
+				return false;
+			runs_.push_back(run);
+			if(std::fwrite(buffer_.data(), sizeof(Rec), buffer_.size(), run) != buffer_.size() || std::fflush(run) != 0)
+				return false;
+			buffer_.clear();
+			return true;
+		}
+
+		void open_merge(size_t first, size_t last){ // readers and heap over runs_[first, last)
+			readers_.clear();
+			heap_.clear();
+			size_t records = std::max<size_t>(1024, read_bytes_ / (last - first) / sizeof(Rec));
+			for(size_t r = first; r < last; r++){
+				readers_.emplace_back(runs_[r], records);
+				Rec rec;
+				if(readers_.back().next(rec))
+					heap_.push_back({rec, r - first});
+			}
+			auto cmp = [this](std::pair<Rec, size_t> const &a, std::pair<Rec, size_t> const &b){ return heap_less(a, b); };
+			std::make_heap(heap_.begin(), heap_.end(), cmp);
+		}
+
+		bool merged_next(Rec &rec){
+			if(heap_.empty())
+				return false;
+			auto cmp = [this](std::pair<Rec, size_t> const &a, std::pair<Rec, size_t> const &b){ return heap_less(a, b); };
+			std::pop_heap(heap_.begin(), heap_.end(), cmp);
+			rec = heap_.back().first;
+			size_t source = heap_.back().second;
+			heap_.pop_back();
+			Rec following;
+			if(readers_[source].next(following)){
+				heap_.push_back({following, source});
+				std::push_heap(heap_.begin(), heap_.end(), cmp);
+			}
+			return true;
+		}
+
+	public:
+
+		external_sorter(size_t mem_bytes, Less less = Less()): less_(less){
+			buffer_cap_ = std::max<size_t>(1024, mem_bytes / sizeof(Rec));
+			read_bytes_ = std::max<size_t>(mem_bytes, 1 << 20);
+			buffer_.reserve(std::min<size_t>(buffer_cap_, 1 << 16));
+		}
+
+		~external_sorter(){
+			for(FILE* run : runs_)
+				if(run != nullptr)
+					std::fclose(run);
+		}
+
+		external_sorter(external_sorter const &) = delete;
+		external_sorter &operator=(external_sorter const &) = delete;
+
+		size_t size() const{ return count_; }
+		size_t runs() const{ return runs_.size(); }
+
+		bool push(Rec const &rec){ // false once a run could not be written
+			buffer_.push_back(rec);
+			count_++;
+			if(buffer_.size() == buffer_cap_ && !spill())
+				failed_ = true;
+			return !failed_;
+		}
+
+		bool finish(){ // no more push() after it
+			if(failed_)
+				return false;
+			if(runs_.empty()){
+				std::sort(buffer_.begin(), buffer_.end(), less_);
+				return true;
+			}
+			if(!buffer_.empty() && !spill())
+				return false;
+			std::vector<Rec>().swap(buffer_);
+
+			// a reader buffer of at least 256 KB per run keeps the reads long
+			size_t fan_in = std::max<size_t>(2, read_bytes_ / (256 << 10));
+			while(runs_.size() > fan_in){
+				std::vector<FILE*> merged;
+				auto fail = [&]{                          // the destructor closes whatever is still open
+					readers_.clear();
+					runs_.insert(runs_.end(), merged.begin(), merged.end());
+					return false;
+				};
+				for(size_t first = 0; first < runs_.size(); first += fan_in){
+					size_t last = std::min(runs_.size(), first + fan_in);
+					if(last - first == 1){
+						merged.push_back(runs_[first]);
+						runs_[first] = nullptr;
+						continue;
+					}
+					FILE* out = temp_file();
+					if(out == nullptr)
+						return fail();
+					merged.push_back(out);
+					open_merge(first, last);
+					std::vector<Rec> chunk;
+					chunk.reserve(4096);
+					Rec rec;
+					while(merged_next(rec)){
+						chunk.push_back(rec);
+						if(chunk.size() == 4096 || heap_.empty()){
+							if(std::fwrite(chunk.data(), sizeof(Rec), chunk.size(), out) != chunk.size())
+								return fail();
+							chunk.clear();
+						}
+					}
+					if(std::fflush(out) != 0)
+						return fail();
+					readers_.clear();
+					for(size_t r = first; r < last; r++){
+						std::fclose(runs_[r]);
+						runs_[r] = nullptr;
+					}
+				}
+				runs_.swap(merged);
+			}
+			open_merge(0, runs_.size());
+			return true;
+		}
+
+		bool next(Rec &rec){ // records in order after finish(), false at the end
+			if(runs_.empty()){
+				if(mem_pos_ == buffer_.size())
+					return false;
+				rec = buffer_[mem_pos_++];
+				return true;
+			}
+			return merged_next(rec);
+		}
+	};
+
+};
@@ -1,8 +1,13 @@
 #include <iostream>
 #include <cstring>
 #include <cstdlib>
-#include <ctime>
+#include <string>
+#include <vector>
+#include <charconv>
 #include "lingeo3D.h"
+#include "tri_io.h"
+#include "scene_gen.h"
+#include "thread_pool.h"
 
 using namespace lingeo3D;
 
@@ -10,45 +15,100 @@ using namespace lingeo3D;
 /*
 	              TRIANGLE GENERATOR
 	  generates a list of *n_tri* triangles that lay in bounds (0.0,0.0,0.0) - (bounds, bounds, bounds)
-	  and are not bigger than cube (abs_size, abs_size, abs_size)
+	  and are not bigger than cube (abs_size, abs_size, abs_size) for the default uniform distribution,
+	  other distributions are described in scene_gen.h
+	  output is the text format by default or the binary container from tri_io.h if "bin" is passed
+	  the scene only depends on the seed (1 unless --seed is given): blocks of triangles are generated and formatted
+	  by the threads in rounds and written in order, so the output is byte-identical for any number of threads
 
 */
 
-template<typename T>
-T random_num_in_bounds(T lower_bound, T upper_bound){
-	return lower_bound + (T)std::rand()/(const T)RAND_MAX * (upper_bound - lower_bound);
-}
+const size_t round_blocks = 64;          // blocks generated between two writes
 
-template<typename T>
-polygon_t<T> generate_triangle(T bounds, T size){
-	polygon_t<T> ret;
-	T actual_size = bounds * size;
-	point_t<T> upper_bounds{random_num_in_bounds(actual_size, bounds), random_num_in_bounds(actual_size, bounds), random_num_in_bounds(actual_size, bounds)};
-	point_t<T> lower_bounds{upper_bounds.x_ - actual_size, upper_bounds.y_ - actual_size, upper_bounds.z_ - actual_size};
-	for (int j = 0; j < 3; j++)
-	{
-		point_t<T> vert{random_num_in_bounds(lower_bounds.x_, upper_bounds.x_),
-					 random_num_in_bounds(lower_bounds.y_, upper_bounds.y_),
-					 random_num_in_bounds(lower_bounds.z_, upper_bounds.z_),};
-		ret.add(vert);
+void append_text(std::string &text, const float* tri){ // one vertex per line and an empty line after the triangle, as polygon_t::print()
+	char num[32];
+	for(int k = 0; k < 9; k++){
+		char* end = std::to_chars(num, num + sizeof(num), tri[k]).ptr;
+		text.append(num, end);
+		text.push_back((k % 3 == 2) ? '\n' : ' ');
 	}
-	return ret;
+	text.push_back('\n');
+}
+
+void usage(){
+	std::cout << "Usage: count bounds size [txt|bin] [--dist uniform|clustered|wide|powerlaw|slivers|coplanar] [--seed S] [--threads N]\n";
 }
 
 int main(int argc, char** argv){
-	if(argc != 4){
-		std::cout << "Usage: count bounds size\n";
+	std::vector<const char*> positional;
+	scene_params_t params;
+	unsigned threads = 0;
+	bool binary = false;
+
+	for(int i = 1; i < argc; i++){
+		if(std::strcmp(argv[i], "--dist") == 0 && i + 1 < argc){
+			if(!scene_kind(argv[++i], params.kind)){
+				usage();
+				return 0;
+			}
+		}
+		else if(std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			params.seed = std::strtoull(argv[++i], nullptr, 10);
+		else if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = std::atoi(argv[++i]);
+		else if(positional.size() == 3 && (std::strcmp(argv[i], "txt") == 0 || std::strcmp(argv[i], "bin") == 0))
+			binary = (std::strcmp(argv[i], "bin") == 0);
+		else if(positional.size() < 3 && argv[i][0] != '-')
+			positional.push_back(argv[i]);
+		else{
+			usage();
+			return 0;
+		}
+	}
+	if(positional.size() != 3){
+		usage();
 		return 0;
 	}
-	int randmax = RAND_MAX;
-	int n_tri = std::atoi(argv[1]);
-	int bounds = std::atoi(argv[2]);
-	int abs_size = std::atoi(argv[3]);
-	std::srand(std::time(nullptr));
-	std::cout << n_tri << std::endl;
-	for(int i = 0; i < n_tri; i++){
-		polygon_t<float> tri = generate_triangle((float)bounds, (float)abs_size/(float)bounds);
-		tri.print();
+	params.count = std::strtoull(positional[0], nullptr, 10);
+	params.bounds = std::atof(positional[1]);
+	params.size = std::atof(positional[2]);
+
+	thread_pool_t pool{threads};
+	size_t blocks = scene_blocks(params);
+	std::vector<float> coords(9 * scene_block * round_blocks);
+	std::vector<std::string> texts(round_blocks);
+
+	tri_writer_t<float>* writer = nullptr;
+	if(binary)
+		writer = new tri_writer_t<float>(stdout, params.count);
+	else
+		std::printf("%zu\n", params.count);
+
+	for(size_t first = 0; first < blocks; first += round_blocks){
+		size_t round = std::min(round_blocks, blocks - first);
+		pool.run(round, [&](unsigned, size_t k){
+			float* block = coords.data() + 9 * scene_block * k;
+			generate_scene_block(params, first + k, block);
+			if(binary)
+				return;
+			size_t n = std::min(scene_block, params.count - (first + k) * scene_block);
+			texts[k].clear();
+			for(size_t t = 0; t < n; t++)
+				append_text(texts[k], block + 9 * t);
+		});
+
+		size_t n = std::min(scene_block * round, params.count - first * scene_block);
+		if(binary)
+			writer->write(coords.data(), n);
+		else
+			for(size_t k = 0; k < round; k++)
+				std::fwrite(texts[k].data(), 1, texts[k].size(), stdout);
 	}
 
-}
\ No newline at end of file
+	if(binary){
+		writer->close();
+		delete writer;
+	}
+	std::fflush(stdout);
+	return 0;
+}
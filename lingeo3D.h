@@ -3,6 +3,9 @@
 #include <array>
 #include <cmath>
 #include <iostream>
+#include <algorithm>
+#include <type_traits>
+#include "predicates.h"
 
 namespace lingeo3D{
 
@@ -14,16 +17,19 @@ namespace lingeo3D{
 	template<typename T>
 	struct point_t {      // (x , y, z)
 		T x_, y_, z_;
-		point_t(T x = NAN, T y = NAN, T z = NAN);
-		point_t(const point_t<T> &point);
+		constexpr point_t(T x = NAN, T y = NAN, T z = NAN): x_(x), y_(y), z_(z){}
 		
 		void print() const;		// prints on screen: "(x ; y)"
 
 		bool valid() const;
 
-		point_t<T> vector_prod(point_t<T> const &pnt) const;
+		constexpr point_t<T> vector_prod(point_t<T> const &pnt) const{
+			return point_t<T>{y_ * pnt.z_ - pnt.y_ * z_, -x_ * pnt.z_ + pnt.x_ * z_, x_ * pnt.y_ - pnt.x_ * y_};
+		}
 
-		T scalar_prod(point_t<T> const &pnt) const;
+		constexpr T scalar_prod(point_t<T> const &pnt) const{
+			return x_*pnt.x_ + y_*pnt.y_ + z_*pnt.z_;
+		}
 
 		T distance(point_t<T> const &pnt) const;
 		
@@ -34,16 +40,16 @@ namespace lingeo3D{
 			return !operator==(pnt);
 		}
 
-		point_t<T> operator-(point_t<T> const &another) const{
+		constexpr point_t<T> operator-(point_t<T> const &another) const{
 			point_t<T> ret(x_ - another.x_, y_ - another.y_, z_ - another.z_);
 			return ret;
 		}
 
-		point_t<T> operator+(point_t const &another) const{
+		constexpr point_t<T> operator+(point_t const &another) const{
 			point_t<T> ret(x_ + another.x_, y_ + another.y_, z_ + another.z_);
 			return ret;	
 		}
-		point_t<T> operator*(float num) const{
+		constexpr point_t<T> operator*(float num) const{
 			point_t<T> ret(x_ * num, y_ * num, z_ * num);
 			return ret;	
 		}
@@ -125,31 +131,79 @@ template<typename T>
 		void add(point_t<T> const &vert);														  // adds the vert to the tail of vertices if its not in vertices already
 	};
 
+template<typename T>
+	struct triangle_t{ // (x1, y1, z1) (x2, y2, z2) (x3, y3, z3) - fixed size counterpart of polygon_t, trivially copyable
+		
+		std::array<point_t<T>, 3> vertices;
 
+		constexpr triangle_t(): vertices{}{}
+		constexpr triangle_t(point_t<T> const &a, point_t<T> const &b, point_t<T> const &c): vertices{a, b, c}{}
+		triangle_t(polygon_t<T> const &polygon);                     // takes the first three vertices, invalid triangle if there are less
+		operator polygon_t<T>() const;
 
+		constexpr point_t<T> const & operator[](int index) const{ return vertices[index]; }
 
+		constexpr point_t<T> edge(int index) const{                   // vector from vertex index to the next one (index is 0, 1 or 2)
+			return vertices[index == 2 ? 0 : index + 1] - vertices[index];
+		}
+		constexpr point_t<T> normal() const{                          // not normalized, same orientation as plane_t(v0, v1, v2)
+			return edge(0).vector_prod(vertices[2] - vertices[0]);
+		}
+		constexpr T offset() const{                                   // d of the plane ax + by + cz + d = 0
+			return -normal().scalar_prod(vertices[0]);
+		}
+		plane_t<T> plane() const;
+		line_t<T> get_side(int index) const;
 
+		bool valid() const;
+		bool degenerate() const;                                          // not valid or without area: a segment or a point, every height below flt_tolerance
+		bool is_divided_by_side_plane(triangle_t<T> const & another) const;
+		bool intersect(triangle_t<T> const & another) const;
+		bool intersect_by_planes(triangle_t<T> const & another) const;   // same question answered with signed plane distances and interval overlap (Moller), no trigonometry
+		bool intersect_exact(triangle_t<T> const & another) const;       // no tolerance: exact orientation predicates (predicates.h), touching counts
+	};
 
+template<typename T>
+	struct alignas(64) tri_plane_t{ // what the plane test reads of a triangle, computed once: a single cache line for float
+		point_t<T> vertices[3];
+		point_t<T> normal;                  // triangle_t::normal()
+		T offset;                           // triangle_t::offset()
+		T eps2;                             // a vertex with squared plane distance below it lies on the plane (flt_tolerance), NaN for an invalid triangle
 
-//******************DEFINITIONS OF TEMPLATE METHODS***********************
+		tri_plane_t() = default;
+		explicit tri_plane_t(triangle_t<T> const &tri);
+		bool valid() const{ return eps2 == eps2; }
+	};
 
+template<typename T>
+	bool planes_intersect(tri_plane_t<T> const &a, tri_plane_t<T> const &b); // triangle_t::intersect_by_planes on precomputed data
+template<typename T>
+	bool coplanar_overlap(tri_plane_t<T> const &a, tri_plane_t<T> const &b); // 2d check for triangles lying in one plane, projected along the longer of the two normals
 
+	// the polygon_t checks above work on plain vertex arrays too, so other storages (e.g. triangle_soup) can use them without building a polygon_t
+template<typename T>
+	bool vertices_valid(point_t<T> const *verts, int n);
+template<typename T>
+	bool divided_by_side_plane(point_t<T> const *verts, int n, point_t<T> const *another, int m); // checks if some plane through a side of verts separates them from another
+template<typename T>
+	bool polygons_intersect(point_t<T> const *verts, int n, point_t<T> const *another, int m);
 
 
 
-	const float pi_ = 3.141593;
 
 
-//*********STRUCT point_t BEGIN**********
 
-template<typename T>
-point_t<T>::point_t(T x, T y, T z): x_(x), y_(y), z_(z){
 
-}
-template<typename T>
-point_t<T>::point_t(const point_t<T> &point): x_(point.x_), y_(point.y_), z_(point.z_){
+//******************DEFINITIONS OF TEMPLATE METHODS***********************
+
 
-}
+
+
+
+	const float pi_ = 3.141593;
+
+
+//*********STRUCT point_t BEGIN**********
 
 
 template<typename T>
@@ -166,16 +220,6 @@ T point_t<T>::distance(point_t<T> const &pnt) const{
 	return std::sqrt(dx * dx + dy * dy + dz * dz);
 }
 
-template<typename T>
-T point_t<T>::scalar_prod(point_t<T> const &pnt) const{
-	return x_*pnt.x_ + y_*pnt.y_ + z_*pnt.z_;
-}
-
-template<typename T>
-point_t<T> point_t<T>::vector_prod(point_t<T> const &pnt) const{
-	return point_t<T>{y_ * pnt.z_ - pnt.y_ * z_, -x_ * pnt.z_ + pnt.x_ * z_, x_ * pnt.y_ - pnt.x_ * y_};
-}
-
 template<typename T>
 bool point_t<T>::valid() const{
 	return (x_ != x_ || y_ != y_ || z_ != z_) ? false : true;
@@ -365,62 +409,309 @@ line_t<T> polygon_t<T>::get_side(int index) const{
 
 template<typename T>
 bool polygon_t<T>::valid() const{
-	if(vertices.size() < 3)
-		return false;
-	
+	return vertices_valid(vertices.data(), vertices.size());
+}
+
+template<typename T>
+bool polygon_t<T>::is_divided_by_side_plane(polygon_t<T> const & another) const{
+	return divided_by_side_plane(vertices.data(), vertices.size(), another.vertices.data(), another.vertices.size());
+}
+
+template<typename T>
+bool polygon_t<T>::intersect(polygon_t<T> const & another) const{
+	return polygons_intersect(vertices.data(), vertices.size(), another.vertices.data(), another.vertices.size());
+}
+
+template<typename T>
+bool polygon_t<T>::holding(point_t<T> const & vert) const{
 	for(int i = 0; i < vertices.size(); i++)
-		if(!vertices[i].valid())
-			return false;
+		if(vert == vertices[i])
+			return true;
+	return false;	
+}
 
-	return true;
+
+template<typename T>
+void polygon_t<T>::add(point_t<T> const &vert){
+	vertices.insert(vertices.end(), vert);
 }
 
+//*********STRUCT polygon_t END**********
+
+//*********STRUCT triangle_t BEGIN*******
+
 template<typename T>
-bool polygon_t<T>::is_divided_by_side_plane(polygon_t<T> const & another) const{
-	for(int i = 0; i < vertices.size(); i++){
+triangle_t<T>::triangle_t(polygon_t<T> const &polygon){
+	for(int i = 0; i < 3; i++)
+		vertices[i] = (i < polygon.vertices.size()) ? polygon.vertices[i] : point_t<T>{};
+}
+
+template<typename T>
+triangle_t<T>::operator polygon_t<T>() const{
+	return polygon_t<T>{{vertices[0], vertices[1], vertices[2]}};
+}
+
+template<typename T>
+plane_t<T> triangle_t<T>::plane() const{
+	point_t<T> norm = normal();
+	return plane_t<T>{norm.x_, norm.y_, norm.z_, offset()};
+}
+
+template<typename T>
+line_t<T> triangle_t<T>::get_side(int index) const{
+	return line_t<T>(vertices[index], vertices[index == 2 ? 0 : index + 1]);
+}
+
+template<typename T>
+bool triangle_t<T>::valid() const{
+	return vertices[0].valid() && vertices[1].valid() && vertices[2].valid();
+}
+
+template<typename T>
+bool triangle_t<T>::degenerate() const{
+	if(!valid())
+		return true;
+	T longest = std::max(edge(0).scalar_prod(edge(0)), std::max(edge(1).scalar_prod(edge(1)), edge(2).scalar_prod(edge(2))));
+	point_t<T> norm = normal();
+	return norm.scalar_prod(norm) <= flt_tolerance * flt_tolerance * longest;   // |normal| = longest side * its height
+}
+
+template<typename T>
+bool triangle_t<T>::is_divided_by_side_plane(triangle_t<T> const & another) const{ // same as divided_by_side_plane() for n = m = 3, unrolled
+	const int opposite[3] = {2, 0, 1};
+	for(int i = 0; i < 3; i++){
 		line_t<T> line = get_side(i);
-		point_t<T> pnt = vertices[(i + 2) % vertices.size()];
-		T max_angle = 0.0;
-		T min_angle = pi_ * 2.0;
-		for(int j = 0; j < another.vertices.size(); j++){
-			T angle = line.angle(pnt, another.vertices[j]);
-			if(angle != angle)
-				return false;
-			if(angle < min_angle) min_angle = angle;
-			if(angle > max_angle) max_angle = angle;
-		}
+		point_t<T> const &pnt = vertices[opposite[i]];
+		T angle0 = line.angle(pnt, another.vertices[0]);
+		T angle1 = line.angle(pnt, another.vertices[1]);
+		T angle2 = line.angle(pnt, another.vertices[2]);
+		if(angle0 != angle0 || angle1 != angle1 || angle2 != angle2)
+			return false;
+		T min_angle = std::min(std::min(angle0, angle1), angle2);
+		T max_angle = std::max(std::max(angle0, angle1), angle2);
 		if(max_angle - min_angle < pi_ && min_angle != 0.0 && max_angle != pi_* 2){
 			return true;
 		}
 	}
-	return false;	
+	return false;
 }
 
 template<typename T>
-bool polygon_t<T>::intersect(polygon_t<T> const & another) const{
+bool triangle_t<T>::intersect(triangle_t<T> const & another) const{
 	if(!valid() || !another.valid()){
 		return false;
 	}
 
 	return (is_divided_by_side_plane(another) || another.is_divided_by_side_plane(*this)) ? false : true;
+}
 
+template<typename T>
+void plane_interval(T p0, T p1, T p2, T d0, T d1, T d2, T &t0, T &t1){ // where the triangle with projections p and plane distances d crosses the line of the two planes
+	// the vertex lying alone on its side of the plane (or the only one off the plane) is the root of both crossed sides
+	int iso = 0;
+	if(d0 * d1 > 0.0)
+		iso = 2;
+	else if(d0 * d2 > 0.0)
+		iso = 1;
+	else if(d1 * d2 > 0.0 || d0 != 0.0)
+		iso = 0;
+	else if(d1 != 0.0)
+		iso = 1;
+	else
+		iso = 2;
+
+	T p[3] = {p0, p1, p2};
+	T d[3] = {d0, d1, d2};
+	int first = (iso == 0) ? 1 : 0;
+	int second = (iso == 2) ? 1 : 2;
+	t0 = p[iso] + (p[first] - p[iso]) * d[iso] / (d[iso] - d[first]);
+	t1 = p[iso] + (p[second] - p[iso]) * d[iso] / (d[iso] - d[second]);
+	if(t0 > t1)
+		std::swap(t0, t1);
 }
 
 template<typename T>
-bool polygon_t<T>::holding(point_t<T> const & vert) const{
-	for(int i = 0; i < vertices.size(); i++)
-		if(vert == vertices[i])
+bool triangle_t<T>::intersect_by_planes(triangle_t<T> const & another) const{
+	return planes_intersect(tri_plane_t<T>{*this}, tri_plane_t<T>{another});
+}
+
+template<typename T>
+bool triangle_t<T>::intersect_exact(triangle_t<T> const & another) const{
+	if(!valid() || !another.valid()){
+		return false;
+	}
+
+	double a[3][3], b[3][3];
+	for(int k = 0; k < 3; k++){
+		a[k][0] = vertices[k].x_; a[k][1] = vertices[k].y_; a[k][2] = vertices[k].z_;
+		b[k][0] = another[k].x_; b[k][1] = another[k].y_; b[k][2] = another[k].z_;
+	}
+	return triangles_intersect_exact(a, b);
+}
+
+static_assert(std::is_trivially_copyable<triangle_t<float>>::value, "triangle_t must stay trivially copyable");
+
+//*********STRUCT triangle_t END*********
+
+//*********STRUCT tri_plane_t BEGIN*******
+
+template<typename T>
+tri_plane_t<T>::tri_plane_t(triangle_t<T> const &tri): vertices{tri[0], tri[1], tri[2]}, normal(tri.normal()), offset(tri.offset()){
+	eps2 = (tri.valid()) ? flt_tolerance * flt_tolerance * normal.scalar_prod(normal) : NAN;
+}
+
+template<typename T>
+bool coplanar_overlap(tri_plane_t<T> const &a, tri_plane_t<T> const &b){
+	// projecting onto the coordinate plane where the triangles have the largest area
+	point_t<T> norm = (a.normal.scalar_prod(a.normal) >= b.normal.scalar_prod(b.normal)) ? a.normal : b.normal;
+	T ax = std::abs(norm.x_), ay = std::abs(norm.y_), az = std::abs(norm.z_);
+	int u = 0, v = 1;
+	if(ax >= ay && ax >= az){
+		u = 1; v = 2;
+	}
+	else if(ay >= az){
+		u = 0; v = 2;
+	}
+	T tri[2][3][2];
+	tri_plane_t<T> const* both[2] = {&a, &b};
+	for(int t = 0; t < 2; t++)
+		for(int k = 0; k < 3; k++){
+			T coords[3] = {both[t]->vertices[k].x_, both[t]->vertices[k].y_, both[t]->vertices[k].z_};
+			tri[t][k][0] = coords[u];
+			tri[t][k][1] = coords[v];
+		}
+
+	// 2d separating axis check: the normals of the six sides are the only candidates
+	for(int t = 0; t < 2; t++)
+		for(int k = 0; k < 3; k++){
+			int next = (k == 2) ? 0 : k + 1;
+			T axis_u = tri[t][next][1] - tri[t][k][1];
+			T axis_v = tri[t][k][0] - tri[t][next][0];
+			T min0 = 0.0, max0 = 0.0, min1 = 0.0, max1 = 0.0;
+			for(int j = 0; j < 3; j++){
+				T proj0 = tri[0][j][0] * axis_u + tri[0][j][1] * axis_v;
+				T proj1 = tri[1][j][0] * axis_u + tri[1][j][1] * axis_v;
+				if(j == 0 || proj0 < min0) min0 = proj0;
+				if(j == 0 || proj0 > max0) max0 = proj0;
+				if(j == 0 || proj1 < min1) min1 = proj1;
+				if(j == 0 || proj1 > max1) max1 = proj1;
+			}
+			if(max0 < min1 || max1 < min0)
+				return false;
+		}
+	return true;
+}
+
+template<typename T>
+bool nearly_parallel(tri_plane_t<T> const &a, tri_plane_t<T> const &b, point_t<T> const &dir){ // dir - a.normal x b.normal
+	// a normal is off by about the rounding of the coordinates over the height of its triangle, so the smaller height
+	// (|normal| over the longest side) decides: planes tilted less than 2 * flt_tolerance over it count as parallel
+	double cross2 = (double)dir.x_ * dir.x_ + (double)dir.y_ * dir.y_ + (double)dir.z_ * dir.z_;
+	double height2 = INFINITY;
+	for(tri_plane_t<T> const* tri : {&a, &b}){
+		double side2 = 0.0;
+		for(int k = 0; k < 3; k++){
+			point_t<T> side = tri->vertices[k == 2 ? 0 : k + 1] - tri->vertices[k];
+			side2 = std::max(side2, (double)side.scalar_prod(side));
+		}
+		height2 = std::min(height2, (double)tri->normal.scalar_prod(tri->normal) / side2);
+	}
+	return cross2 * height2 <= 4.0 * (double)a.eps2 * b.normal.scalar_prod(b.normal);   // sine * height <= 2 * flt_tolerance
+}
+
+template<typename T>
+bool planes_intersect(tri_plane_t<T> const &a, tri_plane_t<T> const &b){
+	if(!a.valid() || !b.valid()){
+		return false;
+	}
+
+	// signed distances of the vertices of a to the plane of b, snapped to zero closer than flt_tolerance (compared squared to skip the sqrt)
+	T da[3];
+	for(int i = 0; i < 3; i++){
+		da[i] = b.normal.scalar_prod(a.vertices[i]) + b.offset;
+		if(da[i] * da[i] < b.eps2) da[i] = 0.0;
+	}
+	if(da[0] * da[1] > 0.0 && da[0] * da[2] > 0.0)       // all of a on one side of the plane of b
+		return false;
+
+	T db[3];
+	for(int i = 0; i < 3; i++){
+		db[i] = a.normal.scalar_prod(b.vertices[i]) + a.offset;
+		if(db[i] * db[i] < a.eps2) db[i] = 0.0;
+	}
+	if(db[0] * db[1] > 0.0 && db[0] * db[2] > 0.0)
+		return false;
+
+	if((da[0] == 0.0 && da[1] == 0.0 && da[2] == 0.0) || (db[0] == 0.0 && db[1] == 0.0 && db[2] == 0.0))
+		return coplanar_overlap(a, b);
+
+	// nearly parallel planes: the line of the planes is lost in rounding and the intervals on it mean nothing, the pair is as good as coplanar
+	point_t<T> dir = a.normal.vector_prod(b.normal);
+	if(nearly_parallel(a, b, dir))
+		return coplanar_overlap(a, b);
+
+	// both triangles cross the line of the two planes, project on its largest direction component and compare the intervals
+	T ax = std::abs(dir.x_), ay = std::abs(dir.y_), az = std::abs(dir.z_);
+	T pa[3], pb[3];
+	for(int i = 0; i < 3; i++){
+		pa[i] = (ax >= ay && ax >= az) ? a.vertices[i].x_ : (ay >= az) ? a.vertices[i].y_ : a.vertices[i].z_;
+		pb[i] = (ax >= ay && ax >= az) ? b.vertices[i].x_ : (ay >= az) ? b.vertices[i].y_ : b.vertices[i].z_;
+	}
+
+	T a0, a1, b0, b1;
+	plane_interval(pa[0], pa[1], pa[2], da[0], da[1], da[2], a0, a1);
+	plane_interval(pb[0], pb[1], pb[2], db[0], db[1], db[2], b0, b1);
+
+	return !(a1 < b0 || b1 < a0);
+}
+
+//*********STRUCT tri_plane_t END*********
+
+//*********VERTEX ARRAY CHECKS BEGIN*****
+
+template<typename T>
+bool vertices_valid(point_t<T> const *verts, int n){
+	if(n < 3)
+		return false;
+	
+	for(int i = 0; i < n; i++)
+		if(!verts[i].valid())
+			return false;
+
+	return true;
+}
+
+template<typename T>
+bool divided_by_side_plane(point_t<T> const *verts, int n, point_t<T> const *another, int m){
+	for(int i = 0; i < n; i++){
+		line_t<T> line(verts[i], verts[(i + 1) % n]);
+		point_t<T> pnt = verts[(i + 2) % n];
+		T max_angle = 0.0;
+		T min_angle = pi_ * 2.0;
+		for(int j = 0; j < m; j++){
+			T angle = line.angle(pnt, another[j]);
+			if(angle != angle)
+				return false;
+			if(angle < min_angle) min_angle = angle;
+			if(angle > max_angle) max_angle = angle;
+		}
+		if(max_angle - min_angle < pi_ && min_angle != 0.0 && max_angle != pi_* 2){
 			return true;
+		}
+	}
 	return false;	
 }
 
-
 template<typename T>
-void polygon_t<T>::add(point_t<T> const &vert){
-	vertices.insert(vertices.end(), vert);
+bool polygons_intersect(point_t<T> const *verts, int n, point_t<T> const *another, int m){
+	if(!vertices_valid(verts, n) || !vertices_valid(another, m)){
+		return false;
+	}
+
+	return (divided_by_side_plane(verts, n, another, m) || divided_by_side_plane(another, m, verts, n)) ? false : true;
 }
 
-//*********STRUCT polygon_t END**********
+//*********VERTEX ARRAY CHECKS END*******
 
 
 
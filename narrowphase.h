@@ -0,0 +1,147 @@
+#pragma once
+#include "lingeo3D.h"
+#include "triangle_soup.h"
+#include "tri_batch.h"
+#include "tri_io.h"
+#include "tri_stats.h"
+#include <atomic>
+#include <memory>
+
+namespace lingeo3D{
+
+/*
+	              INTERSECTED FLAGS
+	  one flag per triangle, shared by all the searching threads: flags only ever go from false to true
+	  and a flag read too early only costs a redundant check, so relaxed atomics are all it takes;
+	  the final values are read after the threads are joined
+
+*/
+
+	class intersect_flags_t{
+
+		std::unique_ptr<std::atomic<bool>[]> flags_;
+		size_t size_;
+
+	public:
+
+		explicit intersect_flags_t(size_t size): flags_(new std::atomic<bool>[size]), size_(size){
+			for(size_t i = 0; i < size_; i++)
+				flags_[i].store(false, std::memory_order_relaxed);
+		}
+
+		size_t size() const{ return size_; }
+
+		bool operator[](size_t i) const{ return flags_[i].load(std::memory_order_relaxed); }
+
+		void set(size_t i){
+			if(!flags_[i].load(std::memory_order_relaxed))   // no cache line traffic for triangles marked already
+				flags_[i].store(true, std::memory_order_relaxed);
+		}
+	};
+
+/*
+	              PAIR CHECKER
+	  receives candidate pairs from a broadphase, runs the chosen narrowphase on them and marks both triangles
+	  of every intersecting pair; pairs whose triangles are both marked already are not checked again
+	  with NARROW_BATCH the candidates of one triangle are collected and checked tri_batch_max at a time,
+	  so flush() has to be called once the broadphase is done
+	  a checker keeps per thread state: every searching thread needs its own, they share the flags
+	  given an output buffer the checker works in all pairs mode: nothing is skipped and every intersecting pair
+	  is written to the buffer as (smaller id, bigger id), ids are the soup indices unless set_ids() maps them
+	  given a second soup the pairs (i, j) are i of the first against j of the second, each with its own flags and ids,
+	  for searching two indexed sets against each other
+
+*/
+
+	class pair_checker_t{
+
+		triangle_soup<float> const &soup_;
+		triangle_soup<float> const &other_;            // of the second triangles of the pairs, soup_ itself by default
+		narrow_t method_;
+		tri_batch_kernel_t kernel_;
+		intersect_flags_t &intersected_;
+		intersect_flags_t &other_intersected_;
+		out_buffer_t* pairs_;
+		const int* ids_ = nullptr;      // output id of every soup index, nullptr - the index itself
+		const int* other_ids_ = nullptr;
+
+		int current_ = -1;              // triangle the batch is collected for
+		triangle_t<float> tri_;
+		tri_batch_t batch_;
+
+		void put_pair(int i, int j){
+			if(ids_ != nullptr)
+				i = ids_[i];
+			if(other_ids_ != nullptr)
+				j = other_ids_[j];
+			pairs_->put_pair(std::min(i, j), std::max(i, j));
+		}
+
+	public:
+
+		pair_checker_t(triangle_soup<float> const &soup, narrow_t method, tri_batch_kernel_t kernel, intersect_flags_t &intersected, out_buffer_t* pairs = nullptr):
+			pair_checker_t(soup, soup, method, kernel, intersected, intersected, pairs){
+
+		}
+
+		pair_checker_t(triangle_soup<float> const &soup, triangle_soup<float> const &other, narrow_t method, tri_batch_kernel_t kernel,
+		               intersect_flags_t &intersected, intersect_flags_t &other_intersected, out_buffer_t* pairs = nullptr):
+			soup_(soup), other_(other), method_(method), kernel_(kernel), intersected_(intersected), other_intersected_(other_intersected), pairs_(pairs){
+
+		}
+
+		bool all_pairs() const{ return pairs_ != nullptr; }
+
+		void set_ids(const int* ids, const int* other_ids = nullptr){ // other_ids for the second soup, the same as ids if not given
+			ids_ = ids;
+			other_ids_ = (other_ids != nullptr) ? other_ids : ids;
+		}
+
+		void operator()(int i, int j){
+			stat_add(STAT_BROAD_PAIRS);
+			if(pairs_ == nullptr && intersected_[i] && other_intersected_[j]){
+				stat_add(STAT_FLAGGED_SKIPS);
+				return;
+			}
+
+			if(method_ != NARROW_BATCH){
+				stat_add(STAT_INTERSECT_CALLS);
+				if(soup_.intersect(i, other_, j, method_)){
+					stat_add(STAT_INTERSECT_HITS);
+					intersected_.set(i);
+					other_intersected_.set(j);
+					if(pairs_ != nullptr)
+						put_pair(i, j);
+				}
+				return;
+			}
+
+			if(i != current_){
+				flush();
+				current_ = i;
+				tri_ = soup_.triangle(i);
+			}
+			batch_.add(other_, j);
+			if(batch_.full())
+				flush();
+		}
+
+		void flush(){
+			if(batch_.empty())
+				return;
+			unsigned hits = kernel_(tri_, batch_);
+			stat_add(STAT_INTERSECT_CALLS, batch_.size);
+			stat_add(STAT_INTERSECT_HITS, __builtin_popcount(hits));
+			for(int lane = 0; lane < batch_.size; lane++)
+				if(hits & (1u << lane)){
+					other_intersected_.set(batch_.ids[lane]);
+					if(pairs_ != nullptr)
+						put_pair(current_, batch_.ids[lane]);
+				}
+			if(hits != 0)
+				intersected_.set(current_);
+			batch_.clear();
+		}
+	};
+
+};
@@ -0,0 +1,144 @@
+#pragma once
+#include "lingeo3D.h"
+#include "triangle_soup.h"
+#include "sorted_cubes.h"
+#include "scene_index.h"
+#include "narrowphase.h"
+#include "thread_pool.h"
+#include "tri_io.h"
+#include "tri_stats.h"
+#include <vector>
+#include <deque>
+#include <cmath>
+#include <algorithm>
+
+namespace lingeo3D{
+
+/*
+	              PIPELINED SEARCH
+	  the search without waiting for the whole input: a triangle_stream_t hands out regions of consecutive ids and
+	  every region is indexed and searched as soon as it is read, while the parser threads go on with the next ones
+	  a region becomes a scene_index (bvh over its boxes): pairs inside it come from its tree against itself, pairs with
+	  an earlier region from its tree against the earlier one (bvh_cross, regions whose bounding boxes don't touch are
+	  skipped), all through the pair checkers, so every pair is checked once, when its bigger id arrives
+	  intersecting pairs are written as they are found, the intersecting ids are final only after the last region
+	  and are written then, in ascending order
+	  each region is traversed against every earlier one: a handful of regions hides most of the reading and costs
+	  little extra
+
+*/
+
+	class pipelined_search{
+
+		struct region_t{
+			scene_index index;
+			int first;                          // id of the first triangle
+			std::vector<int> ids;               // first, first + 1, ... for the pair checkers
+			intersect_flags_t flags;
+			cube_t<float> bounds;
+
+			region_t(triangle_soup<float> soup, int first_id, narrow_t method, tri_batch_kernel_t kernel, unsigned threads):
+				index(std::move(soup), method, kernel, threads), first(first_id), ids(index.size()), flags(index.size()){
+				triangle_soup<float> const &tris = index.soup();
+				float lo[3] = {INFINITY, INFINITY, INFINITY}, hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+				for(size_t i = 0; i < tris.size(); i++){
+					ids[i] = first + i;
+					lo[0] = std::min(lo[0], tris.min_x(i)); hi[0] = std::max(hi[0], tris.max_x(i));
+					lo[1] = std::min(lo[1], tris.min_y(i)); hi[1] = std::max(hi[1], tris.max_y(i));
+					lo[2] = std::min(lo[2], tris.min_z(i)); hi[2] = std::max(hi[2], tris.max_z(i));
+				}
+				bounds = cube_t<float>{lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]};
+			}
+		};
+
+		narrow_t method_;
+		tri_batch_kernel_t kernel_;
+		std::deque<region_t> regions_;
+		size_t size_ = 0;
+
+		void search_inside(region_t &region, thread_pool_t &pool, std::deque<out_buffer_t> &pair_buffers) const{
+			std::vector<pair_checker_t> checkers;
+			for(unsigned w = 0; w < pool.size(); w++){
+				checkers.push_back({region.index.soup(), method_, kernel_, region.flags, pair_buffers.empty() ? nullptr : &pair_buffers[w]});
+				checkers.back().set_ids(region.ids.data());
+			}
+			bvh_tree<float> const &tree = region.index.tree();
+			pool.run(tree.work_size(), [&](unsigned worker, size_t unit){
+				tree.for_each_pair(unit, unit + 1, checkers[worker]);
+				checkers[worker].flush();
+			});
+		}
+
+		void search_across(region_t &region, region_t &earlier, thread_pool_t &pool, std::deque<out_buffer_t> &pair_buffers) const{
+			std::vector<pair_checker_t> checkers;
+			for(unsigned w = 0; w < pool.size(); w++){
+				checkers.push_back({region.index.soup(), earlier.index.soup(), method_, kernel_, region.flags, earlier.flags, pair_buffers.empty() ? nullptr : &pair_buffers[w]});
+				checkers.back().set_ids(region.ids.data(), earlier.ids.data());
+			}
+			bvh_cross<float> cross{region.index.tree(), earlier.index.tree()};
+			pool.run(cross.work_size(), [&](unsigned worker, size_t unit){
+				cross.for_each_pair(unit, unit + 1, checkers[worker]);
+				checkers[worker].flush();
+			});
+		}
+
+	public:
+
+		pipelined_search(narrow_t method, tri_batch_kernel_t kernel): method_(method), kernel_(kernel){
+
+		}
+
+		size_t size() const{ return size_; }
+		size_t regions() const{ return regions_.size(); }
+
+		bool run(triangle_stream_t<float> &input, size_t region_size, thread_pool_t &pool, out_file_t &output, bool all_pairs){ // false if the input turned out malformed, pairs found until then are written
+			std::deque<out_buffer_t> pair_buffers;
+			if(all_pairs)
+				for(unsigned w = 0; w < pool.size(); w++)
+					pair_buffers.emplace_back(output);
+
+			std::vector<float> coords;
+			for(;;){
+				stat_phase_t load{"load"};                 // only the waiting for the parsers
+				size_t first = input.position();
+				if(!input.next(coords, region_size))
+					break;
+				load.stop();
+
+				stat_phase_t build{"build"};
+				regions_.emplace_back(triangle_soup<float>{coords.data(), coords.size() / 9}, first, method_, kernel_, pool.size());
+				build.stop();
+				region_t &region = regions_.back();
+				size_ += region.index.size();
+
+				stat_phase_t search{"search"};
+				search_inside(region, pool, pair_buffers);
+				for(size_t r = 0; r + 1 < regions_.size(); r++)
+					if(region.bounds.interfare(regions_[r].bounds))
+						search_across(region, regions_[r], pool, pair_buffers);
+			}
+			return input.good();
+		}
+
+		size_t write_ids(out_file_t &output) const{ // intersecting ids in ascending order, returns their number
+			size_t hits = 0;
+			out_buffer_t ids{output};
+			for(region_t const &region : regions_)
+				for(size_t i = 0; i < region.ids.size(); i++)
+					if(region.flags[i]){
+						hits++;
+						ids.put(region.ids[i]);
+					}
+			return hits;
+		}
+
+		size_t intersected() const{
+			size_t hits = 0;
+			for(region_t const &region : regions_)
+				for(size_t i = 0; i < region.ids.size(); i++)
+					hits += region.flags[i];
+			return hits;
+		}
+	};
+
+};
@@ -0,0 +1,393 @@
+#pragma once
+#include <cmath>
+
+namespace lingeo3D{
+
+/*
+	              ROBUST PREDICATES
+	  orientation signs decided exactly for double inputs (so for any float input): the determinant is first
+	  evaluated in plain double and accepted when it is farther from zero than its worst case rounding error
+	  (static filter, Shewchuk's bound), only the rare inconclusive cases are recomputed exactly with
+	  floating point expansions (sums of non-overlapping doubles, Shewchuk 1997)
+	  exact up to overflow and underflow, which float coordinates can not reach
+
+	  orient3d(a, b, c, d) - sign of (a - d) . ((b - d) x (c - d)): positive when d lies below the plane of a, b, c
+	                         (a, b, c counterclockwise seen from above), 0 when the four points are coplanar
+	  orient2d(a, b, c)    - sign of (a - c) x (b - c): positive when a, b, c are counterclockwise, 0 on a line
+
+	  triangles_intersect_exact() answers the triangle question with them only (Guigue, Devillers), closed
+	  triangles, touching counts; coplanar pairs and degenerate triangles (segments, points) are exact too
+
+*/
+
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")          // the filter bounds and the error free transforms assume every operation rounds once
+
+//*********EXPANSION ARITHMETIC BEGIN*****
+
+	inline void two_sum(double a, double b, double &sum, double &err){ // sum + err == a + b exactly
+		sum = a + b;
+		double b_virt = sum - a;
+		double a_virt = sum - b_virt;
+		err = (a - a_virt) + (b - b_virt);
+	}
+
+	inline void fast_two_sum(double a, double b, double &sum, double &err){ // same for |a| >= |b|
+		sum = a + b;
+		err = b - (sum - a);
+	}
+
+	inline void two_product(double a, double b, double &prod, double &err){ // prod + err == a * b exactly
+		prod = a * b;
+		err = std::fma(a, b, -prod);
+	}
+
+	// expansions are stored smallest component first, zero components are dropped (zero itself is {0.0})
+
+	inline int grow_expansion(int elen, const double* e, double b, double* h){ // h = e + b, h has room for elen + 1, may be e
+		double q = b;
+		int hlen = 0;
+		for(int i = 0; i < elen; i++){
+			double sum, err;
+			two_sum(q, e[i], sum, err);
+			if(err != 0.0)
+				h[hlen++] = err;
+			q = sum;
+		}
+		if(q != 0.0 || hlen == 0)
+			h[hlen++] = q;
+		return hlen;
+	}
+
+	inline int expansion_sum(int elen, const double* e, int flen, const double* f, double* h){ // h = e + f, room for elen + flen
+		int hlen = elen;
+		for(int i = 0; i < elen; i++)
+			h[i] = e[i];
+		for(int i = 0; i < flen; i++)
+			hlen = grow_expansion(hlen, h, f[i], h);
+		return hlen;
+	}
+
+	inline int scale_expansion(int elen, const double* e, double b, double* h){ // h = e * b, room for 2 * elen
+		double q, err;
+		int hlen = 0;
+		two_product(e[0], b, q, err);
+		if(err != 0.0)
+			h[hlen++] = err;
+		for(int i = 1; i < elen; i++){
+			double p1, p0, sum;
+			two_product(e[i], b, p1, p0);
+			two_sum(q, p0, sum, err);
+			if(err != 0.0)
+				h[hlen++] = err;
+			fast_two_sum(p1, sum, q, err);
+			if(err != 0.0)
+				h[hlen++] = err;
+		}
+		if(q != 0.0 || hlen == 0)
+			h[hlen++] = q;
+		return hlen;
+	}
+
+	inline int product_diff(double a, double b, double c, double d, double* h){ // h = a * b - c * d, room for 4
+		double ab[2], cd[2];
+		two_product(a, b, ab[1], ab[0]);
+		two_product(c, d, cd[1], cd[0]);
+		cd[0] = -cd[0];
+		cd[1] = -cd[1];
+		return expansion_sum(2, ab, 2, cd, h);
+	}
+
+	inline int expansion_sign(int elen, const double* e){ // the largest component decides
+		double top = e[elen - 1];
+		return (top > 0.0) - (top < 0.0);
+	}
+
+//*********EXPANSION ARITHMETIC END*******
+
+//*********ORIENTATION BEGIN*************
+
+	const double pred_epsilon = 1.1102230246251565e-16;                      // 2^-53, half an ulp of 1.0
+	const double orient2d_bound = (3.0 + 16.0 * pred_epsilon) * pred_epsilon;
+	const double orient3d_bound = (7.0 + 56.0 * pred_epsilon) * pred_epsilon;
+
+	inline int det3_exact(const double* p, const double* q, const double* r, double* h){ // det of the rows p, q, r, room for 24
+		double minor[4], term[3][8], sum[16];
+		int len[3];
+		len[0] = scale_expansion(product_diff(q[0], r[1], r[0], q[1], minor), minor, p[2], term[0]);
+		len[1] = scale_expansion(product_diff(p[0], r[1], r[0], p[1], minor), minor, -q[2], term[1]);
+		len[2] = scale_expansion(product_diff(p[0], q[1], q[0], p[1], minor), minor, r[2], term[2]);
+		int slen = expansion_sum(len[0], term[0], len[1], term[1], sum);
+		return expansion_sum(slen, sum, len[2], term[2], h);
+	}
+
+	inline bool exact_diff(double a, double b, double &diff){ // diff = a - b, true when it is exact
+		double err;
+		two_sum(a, -b, diff, err);
+		return err == 0.0;
+	}
+
+	inline int orient3d_exact(const double* a, const double* b, const double* c, const double* d){
+		double ad[3], bd[3], cd[3], det3[24];
+		bool exact = true;
+		for(int k = 0; k < 3; k++){
+			exact &= exact_diff(a[k], d[k], ad[k]);
+			exact &= exact_diff(b[k], d[k], bd[k]);
+			exact &= exact_diff(c[k], d[k], cd[k]);
+		}
+		if(exact)                                 // the usual case for float coordinates: the 3x3 of the differences is enough
+			return expansion_sign(det3_exact(ad, bd, cd, det3), det3);
+
+		// the 4x4 determinant with a column of ones, expanded along it: abc - abd + acd - bcd
+		double abc[24], abd[24], acd[24], bcd[24], left[48], right[48], det[96];
+		int abc_len = det3_exact(a, b, c, abc);
+		int abd_len = det3_exact(a, b, d, abd);
+		int acd_len = det3_exact(a, c, d, acd);
+		int bcd_len = det3_exact(b, c, d, bcd);
+		for(int i = 0; i < abd_len; i++)
+			abd[i] = -abd[i];
+		for(int i = 0; i < bcd_len; i++)
+			bcd[i] = -bcd[i];
+		int left_len = expansion_sum(abc_len, abc, abd_len, abd, left);
+		int right_len = expansion_sum(acd_len, acd, bcd_len, bcd, right);
+		return expansion_sign(expansion_sum(left_len, left, right_len, right, det), det);
+	}
+
+	inline int orient3d(const double* a, const double* b, const double* c, const double* d){
+		double adx = a[0] - d[0], ady = a[1] - d[1], adz = a[2] - d[2];
+		double bdx = b[0] - d[0], bdy = b[1] - d[1], bdz = b[2] - d[2];
+		double cdx = c[0] - d[0], cdy = c[1] - d[1], cdz = c[2] - d[2];
+
+		double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+		double cdxady = cdx * ady, adxcdy = adx * cdy;
+		double adxbdy = adx * bdy, bdxady = bdx * ady;
+		double det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) + cdz * (adxbdy - bdxady);
+		double permanent = (std::abs(bdxcdy) + std::abs(cdxbdy)) * std::abs(adz)
+		                 + (std::abs(cdxady) + std::abs(adxcdy)) * std::abs(bdz)
+		                 + (std::abs(adxbdy) + std::abs(bdxady)) * std::abs(cdz);
+		double bound = orient3d_bound * permanent;
+		if(det > bound)
+			return 1;
+		if(-det > bound)
+			return -1;
+		if(permanent == 0.0)                      // every product is zero: points in an axis aligned plane, no rounding at all
+			return 0;
+		return orient3d_exact(a, b, c, d);
+	}
+
+	inline int orient2d_exact(const double* a, const double* b, const double* c){
+		double acx, acy, bcx, bcy, minor[4];
+		if(exact_diff(a[0], c[0], acx) & exact_diff(a[1], c[1], acy) & exact_diff(b[0], c[0], bcx) & exact_diff(b[1], c[1], bcy))
+			return expansion_sign(product_diff(acx, bcy, acy, bcx, minor), minor);
+
+		// a.x b.y - a.y b.x + b.x c.y - b.y c.x + c.x a.y - c.y a.x
+		double ab[4], bc[4], ca[4], sum[8], det[12];
+		int ab_len = product_diff(a[0], b[1], a[1], b[0], ab);
+		int bc_len = product_diff(b[0], c[1], b[1], c[0], bc);
+		int ca_len = product_diff(c[0], a[1], c[1], a[0], ca);
+		int sum_len = expansion_sum(ab_len, ab, bc_len, bc, sum);
+		return expansion_sign(expansion_sum(sum_len, sum, ca_len, ca, det), det);
+	}
+
+	inline int orient2d(const double* a, const double* b, const double* c){
+		double left = (a[0] - c[0]) * (b[1] - c[1]);
+		double right = (a[1] - c[1]) * (b[0] - c[0]);
+		double det = left - right;
+		double bound = orient2d_bound * (std::abs(left) + std::abs(right));
+		if(det > bound)
+			return 1;
+		if(-det > bound)
+			return -1;
+		if(bound == 0.0)
+			return 0;
+		return orient2d_exact(a, b, c);
+	}
+
+//*********ORIENTATION END***************
+
+//*********EXACT TRIANGLE TEST BEGIN*****
+
+	inline void drop_axis(const double* p, int axis, double* out){ // projection onto the coordinate plane orthogonal to axis
+		out[0] = p[axis == 0 ? 1 : 0];
+		out[1] = p[axis == 2 ? 1 : 2];
+	}
+
+	inline int flat_axis(const double* a, const double* b, const double* c){ // axis whose projection keeps a, b, c a triangle, -1 if they are on one line
+		for(int axis = 0; axis < 3; axis++){
+			double pa[2], pb[2], pc[2];
+			drop_axis(a, axis, pa);
+			drop_axis(b, axis, pb);
+			drop_axis(c, axis, pc);
+			if(orient2d(pa, pb, pc) != 0)
+				return axis;
+		}
+		return -1;
+	}
+
+	inline bool on_segment_2d(const double* p, const double* q, const double* r){ // r known to be on the line pq (or p == q)
+		return std::fmin(p[0], q[0]) <= r[0] && r[0] <= std::fmax(p[0], q[0]) &&
+		       std::fmin(p[1], q[1]) <= r[1] && r[1] <= std::fmax(p[1], q[1]);
+	}
+
+	inline bool segments_intersect_2d(const double* p, const double* q, const double* a, const double* b){ // closed segments, points allowed
+		int o1 = orient2d(p, q, a), o2 = orient2d(p, q, b);
+		int o3 = orient2d(a, b, p), o4 = orient2d(a, b, q);
+		if(o1 * o2 < 0 && o3 * o4 < 0)
+			return true;
+		return (o1 == 0 && on_segment_2d(p, q, a)) || (o2 == 0 && on_segment_2d(p, q, b)) ||
+		       (o3 == 0 && on_segment_2d(a, b, p)) || (o4 == 0 && on_segment_2d(a, b, q));
+	}
+
+	inline bool inside_triangle_2d(const double (*t)[2], const double* p){ // closed, t is not degenerate
+		int s0 = orient2d(t[0], t[1], p), s1 = orient2d(t[1], t[2], p), s2 = orient2d(t[2], t[0], p);
+		return !((s0 > 0 || s1 > 0 || s2 > 0) && (s0 < 0 || s1 < 0 || s2 < 0));
+	}
+
+	inline bool segment_triangle_2d(const double* p, const double* q, const double (*t)[2]){
+		if(inside_triangle_2d(t, p) || inside_triangle_2d(t, q))
+			return true;
+		for(int k = 0; k < 3; k++)
+			if(segments_intersect_2d(p, q, t[k], t[(k + 1) % 3]))
+				return true;
+		return false;
+	}
+
+	inline bool segment_triangle_exact(const double* p, const double* q, const double (*t)[3]){ // t is not degenerate
+		int sp = orient3d(t[0], t[1], t[2], p), sq = orient3d(t[0], t[1], t[2], q);
+		if(sp * sq > 0)
+			return false;
+		if(sp == 0 && sq == 0){
+			int axis = flat_axis(t[0], t[1], t[2]);
+			double pp[2], pq[2], pt[3][2];
+			drop_axis(p, axis, pp);
+			drop_axis(q, axis, pq);
+			for(int k = 0; k < 3; k++)
+				drop_axis(t[k], axis, pt[k]);
+			return segment_triangle_2d(pp, pq, pt);
+		}
+		// the segment meets the plane in one point, it is in the triangle when the line pq passes no edge on the outside
+		int e0 = orient3d(p, q, t[0], t[1]), e1 = orient3d(p, q, t[1], t[2]), e2 = orient3d(p, q, t[2], t[0]);
+		return !((e0 > 0 || e1 > 0 || e2 > 0) && (e0 < 0 || e1 < 0 || e2 < 0));
+	}
+
+	inline bool segments_intersect_exact(const double* p, const double* q, const double* a, const double* b){
+		if(orient3d(p, q, a, b) != 0)
+			return false;
+		const double* pts[4] = {p, q, a, b};
+		for(int k = 0; k < 4; k++){                       // a projection where some three of the points still make a triangle
+			int axis = flat_axis(pts[k == 0 ? 1 : 0], pts[k <= 1 ? 2 : 1], pts[k <= 2 ? 3 : 2]);
+			if(axis < 0)
+				continue;
+			double pp[2], pq[2], pa[2], pb[2];
+			drop_axis(p, axis, pp);
+			drop_axis(q, axis, pq);
+			drop_axis(a, axis, pa);
+			drop_axis(b, axis, pb);
+			return segments_intersect_2d(pp, pq, pa, pb);
+		}
+		for(int axis = 0; axis < 3; axis++)               // all four on one line: compare the intervals along a coordinate it is not constant in
+			if(p[axis] != q[axis] || p[axis] != a[axis] || p[axis] != b[axis])
+				return std::fmax(std::fmin(p[axis], q[axis]), std::fmin(a[axis], b[axis])) <=
+				       std::fmin(std::fmax(p[axis], q[axis]), std::fmax(a[axis], b[axis]));
+		return true;
+	}
+
+	inline bool flat_triangles_intersect(const double (*a)[3], const double (*b)[3]){ // coplanar triangles or at least one of them degenerate
+		int axis_a = flat_axis(a[0], a[1], a[2]), axis_b = flat_axis(b[0], b[1], b[2]);
+		if(axis_a >= 0 && axis_b >= 0){                 // coplanar: one projection serves both
+			double pa[3][2], pb[3][2];
+			for(int k = 0; k < 3; k++){
+				drop_axis(a[k], axis_a, pa[k]);
+				drop_axis(b[k], axis_a, pb[k]);
+			}
+			for(int i = 0; i < 3; i++)
+				if(segment_triangle_2d(pa[i], pa[(i + 1) % 3], pb))
+					return true;
+			return inside_triangle_2d(pa, pb[0]);
+		}
+		if(axis_b >= 0){                                // a is a segment (or a point): one of its sides covers it
+			for(int i = 0; i < 3; i++)
+				if(segment_triangle_exact(a[i], a[(i + 1) % 3], b))
+					return true;
+			return false;
+		}
+		if(axis_a >= 0)
+			return flat_triangles_intersect(b, a);
+		for(int i = 0; i < 3; i++)
+			for(int j = 0; j < 3; j++)
+				if(segments_intersect_exact(a[i], a[(i + 1) % 3], b[j], b[(j + 1) % 3]))
+					return true;
+		return false;
+	}
+
+	inline bool interval_overlap_exact(const double* p1, const double* q1, const double* r1, const double* p2, const double* q2, const double* r2){
+		// p1 and p2 alone on their sides of the other plane, q1 r1 and q2 r2 in the order that compares the segments on the common line
+		return orient3d(q2, p2, p1, q1) <= 0 && orient3d(r2, p2, r1, p1) <= 0;
+	}
+
+	inline bool crossing_triangles_exact(const double* p1, const double* q1, const double* r1, const double* p2, const double* q2, const double* r2,
+	                                     int dp2, int dq2, int dr2){ // p1 alone on its side of plane 2, d?2 - sides of triangle 2 vertices to plane 1
+		if(dp2 > 0){
+			if(dq2 > 0) return interval_overlap_exact(p1, r1, q1, r2, p2, q2);
+			if(dr2 > 0) return interval_overlap_exact(p1, r1, q1, q2, r2, p2);
+			return interval_overlap_exact(p1, q1, r1, p2, q2, r2);
+		}
+		if(dp2 < 0){
+			if(dq2 < 0) return interval_overlap_exact(p1, q1, r1, r2, p2, q2);
+			if(dr2 < 0) return interval_overlap_exact(p1, q1, r1, q2, r2, p2);
+			return interval_overlap_exact(p1, r1, q1, p2, q2, r2);
+		}
+		if(dq2 < 0){
+			if(dr2 >= 0) return interval_overlap_exact(p1, r1, q1, q2, r2, p2);
+			return interval_overlap_exact(p1, q1, r1, p2, q2, r2);
+		}
+		if(dq2 > 0){
+			if(dr2 > 0) return interval_overlap_exact(p1, r1, q1, p2, q2, r2);
+			return interval_overlap_exact(p1, q1, r1, q2, r2, p2);
+		}
+		if(dr2 > 0) return interval_overlap_exact(p1, q1, r1, r2, p2, q2);
+		return interval_overlap_exact(p1, r1, q1, r2, p2, q2);     // dr2 < 0, all zero is the flat case
+	}
+
+	inline bool triangles_intersect_exact(const double (*a)[3], const double (*b)[3]){
+		const double *p1 = a[0], *q1 = a[1], *r1 = a[2];
+		const double *p2 = b[0], *q2 = b[1], *r2 = b[2];
+
+		// sides of the vertices to the other plane, positive where its normal (q - p) x (r - p) points
+		int dp1 = orient3d(p2, r2, q2, p1), dq1 = orient3d(p2, r2, q2, q1), dr1 = orient3d(p2, r2, q2, r1);
+		if(dp1 * dq1 > 0 && dp1 * dr1 > 0)             // a strictly on one side of the plane of b
+			return false;
+		int dp2 = orient3d(p1, r1, q1, p2), dq2 = orient3d(p1, r1, q1, q2), dr2 = orient3d(p1, r1, q1, r2);
+		if(dp2 * dq2 > 0 && dp2 * dr2 > 0)
+			return false;
+		if((dp1 == 0 && dq1 == 0 && dr1 == 0) || (dp2 == 0 && dq2 == 0 && dr2 == 0))
+			return flat_triangles_intersect(a, b);      // a degenerate triangle has no plane and zeroes the other side too
+
+		// rotate a so that p1 is alone on its side of plane b, swapping q2 r2 keeps the orientation consistent
+		if(dp1 > 0){
+			if(dq1 > 0) return crossing_triangles_exact(r1, p1, q1, p2, r2, q2, dp2, dr2, dq2);
+			if(dr1 > 0) return crossing_triangles_exact(q1, r1, p1, p2, r2, q2, dp2, dr2, dq2);
+			return crossing_triangles_exact(p1, q1, r1, p2, q2, r2, dp2, dq2, dr2);
+		}
+		if(dp1 < 0){
+			if(dq1 < 0) return crossing_triangles_exact(r1, p1, q1, p2, q2, r2, dp2, dq2, dr2);
+			if(dr1 < 0) return crossing_triangles_exact(q1, r1, p1, p2, q2, r2, dp2, dq2, dr2);
+			return crossing_triangles_exact(p1, q1, r1, p2, r2, q2, dp2, dr2, dq2);
+		}
+		if(dq1 < 0){
+			if(dr1 >= 0) return crossing_triangles_exact(q1, r1, p1, p2, r2, q2, dp2, dr2, dq2);
+			return crossing_triangles_exact(p1, q1, r1, p2, q2, r2, dp2, dq2, dr2);
+		}
+		if(dq1 > 0){
+			if(dr1 > 0) return crossing_triangles_exact(p1, q1, r1, p2, r2, q2, dp2, dr2, dq2);
+			return crossing_triangles_exact(q1, r1, p1, p2, q2, r2, dp2, dq2, dr2);
+		}
+		if(dr1 > 0) return crossing_triangles_exact(r1, p1, q1, p2, q2, r2, dp2, dq2, dr2);
+		return crossing_triangles_exact(r1, p1, q1, p2, r2, q2, dp2, dr2, dq2);
+	}
+
+//*********EXACT TRIANGLE TEST END*******
+
+#pragma GCC pop_options
+
+};
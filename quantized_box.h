@@ -0,0 +1,83 @@
+#pragma once
+#include "lingeo3D.h"
+#include "triangle_soup.h"
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+namespace lingeo3D{
+
+/*
+	              QUANTIZED BOXES
+	  a box in 16 bits per bound (12 bytes instead of 24 for cube_t<float>) on a grid of 65535 steps over the scene
+	  bounds, for broadphase loops that stream over many boxes and reject most of them
+	  every bound is widened by flt_tolerance plus a few float ulps of the scene magnitude and rounded outward,
+	  bounds outside the scene clamp to its edge and NaN gives the whole range: whenever the float test
+	  (cube_t::x_interfere with its tolerance) passes, the integer one passes too, so the integer test only
+	  throws away pairs the float test would throw away as well and the survivors get the float test as before
+
+*/
+
+	struct qbox_t{
+		uint16_t lo[3], hi[3];
+
+		bool axis_overlap(qbox_t const &box, int axis) const{
+			return box.lo[axis] <= hi[axis] && lo[axis] <= box.hi[axis];
+		}
+
+		bool overlap(qbox_t const &box) const{
+			return axis_overlap(box, 0) && axis_overlap(box, 1) && axis_overlap(box, 2);
+		}
+	};
+
+template<typename T>
+	class box_quantizer_t{
+
+		double origin_[3] = {0.0, 0.0, 0.0};
+		double scale_[3] = {0.0, 0.0, 0.0};   // steps per unit, 0 - a flat scene, everything in step 0
+		double pad_ = flt_tolerance;
+
+		uint16_t step(double v, int axis, bool up) const{
+			double s = (v - origin_[axis]) * scale_[axis];
+			if(std::isnan(s))
+				return up ? 65535 : 0;
+			s = up ? std::ceil(s) : std::floor(s);
+			return (uint16_t)std::max(0.0, std::min(65535.0, s));
+		}
+
+	public:
+
+		box_quantizer_t(){}
+
+		explicit box_quantizer_t(triangle_soup<T> const &soup){ // grid over the boxes of the soup
+			double lo[3] = {INFINITY, INFINITY, INFINITY}, hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+			for(size_t i = 0; i < soup.size(); i++){
+				double box[2][3] = {{soup.min_x(i), soup.min_y(i), soup.min_z(i)}, {soup.max_x(i), soup.max_y(i), soup.max_z(i)}};
+				for(int a = 0; a < 3; a++){
+					lo[a] = std::min(lo[a], box[0][a]);      // NaN drops out
+					hi[a] = std::max(hi[a], box[1][a]);
+				}
+			}
+			double magnitude = 0.0;                          // of any bound, padded boxes (sorted_cubes) included
+			for(int a = 0; a < 3; a++){
+				if(!(lo[a] <= hi[a]))
+					continue;
+				magnitude = std::max(magnitude, std::max(std::abs(lo[a]), std::abs(hi[a])) + (hi[a] - lo[a]));
+				origin_[a] = lo[a];
+				scale_[a] = (hi[a] > lo[a]) ? 65535.0 / (hi[a] - lo[a]) : 0.0;
+			}
+			pad_ = flt_tolerance + magnitude * std::ldexp(1.0, -20);   // covers the rounding of the float bound +- flt_tolerance
+		}
+
+		qbox_t operator()(T min_x, T min_y, T min_z, T max_x, T max_y, T max_z) const{
+			double lo[3] = {min_x, min_y, min_z}, hi[3] = {max_x, max_y, max_z};
+			qbox_t box;
+			for(int a = 0; a < 3; a++){
+				box.lo[a] = step(lo[a] - pad_, a, false);
+				box.hi[a] = step(hi[a] + pad_, a, true);
+			}
+			return box;
+		}
+	};
+
+};
@@ -0,0 +1,185 @@
+#pragma once
+#include "lingeo3D.h"
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+namespace lingeo3D{
+
+/*
+	              SCENE GENERATOR
+	  fixed-seed synthetic scenes: the same parameters and seed give the same triangles on every run,
+	  only integer generators and explicit float math are used
+	  triangles are made in blocks of scene_block, every block draws from its own xoshiro256** stream seeded
+	  by (seed, block), so blocks can be generated by any number of threads in any order with the same result
+
+	  uniform   - triangles no bigger than size, spread evenly over the bounds cube
+	  clustered - the same triangles around a few dozen centres, gaussian with sigma bounds / 32
+	  wide      - triangle sizes log-uniform over three orders of magnitude, from about size / 300 to size * 3
+	  powerlaw  - pareto sizes (alpha 1.5) from size / 10 up to bounds / 4: mostly small triangles and a heavy tail
+	  slivers   - near-degenerate needles and caps: the third vertex lies 1e-4 * size off the line of the other two
+	  coplanar  - triangles lying (up to a tiny noise) in a handful of horizontal sheets
+
+*/
+
+	struct splitmix64_t{ // seeding only
+		uint64_t state;
+
+		explicit splitmix64_t(uint64_t seed): state(seed){}
+
+		uint64_t next(){
+			uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			return z ^ (z >> 31);
+		}
+	};
+
+	struct xoshiro256_t{ // xoshiro256** (Blackman, Vigna)
+		uint64_t s[4];
+
+		explicit xoshiro256_t(uint64_t seed){
+			splitmix64_t mix{seed};
+			for(int k = 0; k < 4; k++)
+				s[k] = mix.next();
+		}
+
+		static uint64_t rotl(uint64_t x, int k){
+			return (x << k) | (x >> (64 - k));
+		}
+
+		uint64_t next(){
+			uint64_t result = rotl(s[1] * 5, 7) * 9;
+			uint64_t t = s[1] << 17;
+			s[2] ^= s[0];
+			s[3] ^= s[1];
+			s[1] ^= s[2];
+			s[0] ^= s[3];
+			s[2] ^= t;
+			s[3] = rotl(s[3], 45);
+			return result;
+		}
+
+		double uniform(){ // [0, 1) out of the top 53 bits
+			return (next() >> 11) * (1.0 / 9007199254740992.0);
+		}
+
+		double uniform(double lo, double hi){
+			return lo + uniform() * (hi - lo);
+		}
+
+		double gaussian(){ // Box-Muller, one value per call
+			double u = 1.0 - uniform();
+			double v = uniform();
+			return std::sqrt(-2.0 * std::log(u)) * std::cos(6.283185307179586 * v);
+		}
+	};
+
+	enum scene_kind_t {SCENE_UNIFORM, SCENE_CLUSTERED, SCENE_WIDE, SCENE_POWERLAW, SCENE_SLIVERS, SCENE_COPLANAR};
+
+	const char* const scene_names[] = {"uniform", "clustered", "wide", "powerlaw", "slivers", "coplanar"};
+	const int scene_kinds = 6;
+	const size_t scene_block = 4096;
+
+	inline bool scene_kind(const char* name, scene_kind_t &kind){ // false on unknown name
+		for(int k = 0; k < scene_kinds; k++)
+			if(std::strcmp(name, scene_names[k]) == 0){
+				kind = (scene_kind_t)k;
+				return true;
+			}
+		return false;
+	}
+
+	struct scene_params_t{
+		scene_kind_t kind = SCENE_UNIFORM;
+		size_t count = 0;
+		double bounds = 100.0;        // scene fits (0, 0, 0) - (bounds, bounds, bounds)
+		double size = 1.0;            // typical triangle extent
+		uint64_t seed = 1;
+	};
+
+	inline xoshiro256_t scene_stream(uint64_t seed, uint64_t stream){
+		splitmix64_t mix{seed ^ 0x5851f42d4c957f2dULL};
+		mix.state += stream * 0x9e3779b97f4a7c15ULL;
+		return xoshiro256_t{mix.next()};
+	}
+
+	inline size_t scene_blocks(scene_params_t const &params){
+		return (params.count + scene_block - 1) / scene_block;
+	}
+
+	template<typename T>
+	void generate_scene_block(scene_params_t const &params, size_t block, T* coords){ // triangles of one block, 9 coordinates each, coords points at the first of them
+		const int clusters = 32, sheets = 8;
+		const double b = params.bounds;
+		size_t begin = block * scene_block;
+		size_t end = std::min(params.count, begin + scene_block);
+		xoshiro256_t rng = scene_stream(params.seed, block);
+
+		for(size_t i = begin; i < end; i++){
+			double size = params.size;
+			if(params.kind == SCENE_WIDE)
+				size = params.size * std::pow(10.0, rng.uniform(-2.5, 0.5));
+			else if(params.kind == SCENE_POWERLAW)
+				size = std::min(b / 4.0, params.size / 10.0 * std::pow(1.0 - rng.uniform(), -1.0 / 1.5));
+
+			double half = std::min(size, b) / 2.0;
+			double c[3];
+			if(params.kind == SCENE_CLUSTERED){
+				xoshiro256_t centre = scene_stream(params.seed, ~(rng.next() % clusters));
+				for(int k = 0; k < 3; k++)
+					c[k] = centre.uniform(0.0, b) + rng.gaussian() * b / 32.0;
+			}
+			else
+				for(int k = 0; k < 3; k++)
+					c[k] = rng.uniform(0.0, b);
+			for(int k = 0; k < 3; k++)                 // whole triangle inside the bounds
+				c[k] = std::min(b - half, std::max(half, c[k]));
+
+			double v[3][3];
+			for(int k = 0; k < 3; k++)
+				for(int a = 0; a < 3; a++)
+					v[k][a] = c[a] + rng.uniform(-0.5, 0.5) * size;
+
+			if(params.kind == SCENE_COPLANAR){
+				double flat = b * ((rng.next() % sheets) + 0.5) / sheets;
+				for(int k = 0; k < 3; k++)
+					v[k][2] = flat + rng.uniform(-0.5, 0.5) * size * 1e-6;
+			}
+			else if(params.kind == SCENE_SLIVERS){
+				double t = rng.uniform(-0.2, 1.2);        // beyond the ends makes needles, between them caps
+				for(int a = 0; a < 3; a++)
+					v[2][a] = v[0][a] + t * (v[1][a] - v[0][a]) + rng.uniform(-0.5, 0.5) * size * 1e-4;
+			}
+
+			T* tri = coords + 9 * (i - begin);
+			for(int k = 0; k < 3; k++)
+				for(int a = 0; a < 3; a++)
+					tri[3 * k + a] = v[k][a];
+		}
+	}
+
+	template<typename T>
+	void generate_scene(scene_params_t const &params, std::vector<T> &coords, unsigned threads = 0){ // threads 0 - as many as the hardware has, the result does not depend on it
+		coords.resize(9 * params.count);
+		if(threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		size_t blocks = scene_blocks(params);
+		threads = std::min<size_t>(threads, std::max<size_t>(blocks, 1));
+
+		auto work = [&](unsigned t){
+			for(size_t block = t; block < blocks; block += threads)
+				generate_scene_block(params, block, coords.data() + 9 * block * scene_block);
+		};
+		std::vector<std::thread> workers;
+		for(unsigned t = 1; t < threads; t++)
+			workers.emplace_back(work, t);
+		work(0);
+		for(auto &w : workers)
+			w.join();
+	}
+
+};
@@ -0,0 +1,109 @@
+#pragma once
+#include "lingeo3D.h"
+#include "triangle_soup.h"
+#include "sorted_cubes.h"
+#include "bvh.h"
+#include "tri_batch.h"
+#include <vector>
+#include <algorithm>
+
+namespace lingeo3D{
+
+/*
+	              SCENE INDEX
+	  library entry for checking other triangle sets against a fixed one: the index is built once from set A
+	  (a bounding volume hierarchy over its boxes) and query() takes a set B, every B triangle walks the tree
+	  and is checked against the A triangles whose boxes it touches
+	  the result lists the B triangles hitting A, the A triangles hit by B or both; pairs inside A or inside B
+	  are not checked
+	  query() only reads the index and keeps its state on the stack, so any number of threads may query one index at once
+
+*/
+
+	enum query_side_t {QUERY_B = 1, QUERY_A = 2, QUERY_BOTH = 3};
+
+	struct query_result_t{
+		std::vector<int> b_hits;      // indices in B of triangles intersecting A, ascending
+		std::vector<int> a_hits;      // indices in A of triangles intersected by B, ascending
+	};
+
+	class scene_index{
+
+		triangle_soup<float> soup_;
+		bvh_tree<float> tree_;
+		narrow_t method_;
+		tri_batch_kernel_t kernel_;
+
+		bool narrow(triangle_t<float> const &tri, tri_plane_t<float> const &plane, int a) const{ // plane of tri is only filled in for NARROW_PLANES
+			if(method_ == NARROW_ANGLE)
+				return tri.intersect(soup_.triangle(a));
+			if(method_ == NARROW_EXACT)
+				return tri.intersect_exact(soup_.triangle(a));
+			return planes_intersect(plane, soup_.plane(a));
+		}
+
+	public:
+
+		scene_index(triangle_soup<float> soup, narrow_t method = NARROW_BATCH, tri_batch_kernel_t kernel = tri_batch_kernel(), unsigned threads = 0):
+			soup_(std::move(soup)), tree_(soup_, threads), method_(method), kernel_(kernel){
+			if(method_ == NARROW_PLANES)
+				soup_.cache_planes();
+
+		}
+
+		size_t size() const{ return soup_.size(); }
+		triangle_soup<float> const &soup() const{ return soup_; }
+		bvh_tree<float> const &tree() const{ return tree_; }
+
+		query_result_t query(triangle_soup<float> const &b, query_side_t side = QUERY_BOTH) const{
+			query_result_t result;
+			std::vector<int> candidates;
+			tri_batch_t batch;
+
+			for(int i = 0; i < b.size(); i++){
+				candidates.clear();
+				tree_.for_each_overlap(cube_t<float>{b, i}, [&](int a){ candidates.push_back(a); });
+				if(candidates.empty())
+					continue;
+
+				triangle_t<float> tri = b.triangle(i);
+				tri_plane_t<float> plane;
+				if(method_ == NARROW_PLANES)
+					plane = tri_plane_t<float>{tri};
+				bool hit = false;
+				for(size_t k = 0; k < candidates.size(); k++){
+					if(hit && side == QUERY_B)                   // the rest could only add A hits
+						break;
+					if(method_ != NARROW_BATCH){
+						if(narrow(tri, plane, candidates[k])){
+							hit = true;
+							if(side & QUERY_A)
+								result.a_hits.push_back(candidates[k]);
+						}
+						continue;
+					}
+					batch.add(soup_, candidates[k]);
+					if(!batch.full() && k + 1 < candidates.size())
+						continue;
+					unsigned hits = kernel_(tri, batch);
+					for(int lane = 0; hits != 0 && lane < batch.size; lane++)
+						if(hits & (1u << lane)){
+							hit = true;
+							if(side & QUERY_A)
+								result.a_hits.push_back(batch.ids[lane]);
+						}
+					batch.clear();
+				}
+				batch.clear();
+
+				if(hit && (side & QUERY_B))
+					result.b_hits.push_back(i);
+			}
+
+			std::sort(result.a_hits.begin(), result.a_hits.end());
+			result.a_hits.erase(std::unique(result.a_hits.begin(), result.a_hits.end()), result.a_hits.end());
+			return result;
+		}
+	};
+
+};
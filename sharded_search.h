@@ -0,0 +1,234 @@
+#pragma once
+#include "lingeo3D.h"
+#include "triangle_soup.h"
+#include "narrowphase.h"
+#include "thread_pool.h"
+#include "tri_io.h"
+#include <vector>
+#include <deque>
+#include <thread>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <algorithm>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace lingeo3D{
+
+/*
+	              SHARDED SEARCH
+	  the search split between processes: space is cut into slabs across the axis the box centres spread most along,
+	  with about the same number of triangles in each, and every slab goes to a shard, a child process forked
+	  off the coordinator; the children share the loaded soup with it (copy on write, nothing is copied unless written)
+	  a triangle belongs to every slab its box touches, widened by flt_tolerance and a few float ulps of its
+	  magnitude, so two triangles whose boxes the broadphases let through share a slab and every pair is found
+	  in at least one shard; each shard runs the usual broadphase and narrowphase over its own triangles with its
+	  own thread pool and sends the ids (or the pairs) back through a pipe as binary uint32
+	  the coordinator merges: an id is intersecting if any shard says so, a pair found in several shards is kept only
+	  from the last slab both of its triangles start in, so the answer is exactly that of a single process
+	  fork() comes before any thread of the coordinator is started, run() has to be called before the thread pool exists
+
+*/
+
+	class sharded_search{
+
+		int shards_;
+		int axis_ = 0;
+		std::vector<double> cuts_;               // slab s is [cuts_[s - 1], cuts_[s]) along axis_
+		std::vector<int> first_, last_;         // slabs of every triangle
+		size_t copies_ = 0;
+
+		int slab_of(double v) const{
+			return std::upper_bound(cuts_.begin(), cuts_.end(), v) - cuts_.begin();
+		}
+
+		static float min_of(triangle_soup<float> const &soup, size_t i, int axis){
+			return axis == 0 ? soup.min_x(i) : (axis == 1 ? soup.min_y(i) : soup.min_z(i));
+		}
+
+		static float max_of(triangle_soup<float> const &soup, size_t i, int axis){
+			return axis == 0 ? soup.max_x(i) : (axis == 1 ? soup.max_y(i) : soup.max_z(i));
+		}
+
+		template<typename Search>
+		void search_shard(int shard, int fd, triangle_soup<float> const &soup, unsigned threads, narrow_t method, tri_batch_kernel_t kernel, bool all_pairs, Search &&search) const{ // in the child
+			std::vector<int> members;
+			for(size_t i = 0; i < soup.size(); i++)
+				if(first_[i] <= shard && shard <= last_[i])
+					members.push_back(i);
+			triangle_soup<float> part;
+			part.resize(members.size());
+			if(soup.planes_cached())
+				part.cache_planes();
+			for(size_t k = 0; k < members.size(); k++)
+				part.set(k, soup.triangle(members[k]));
+
+			out_file_t sink{OUT_BINARY};
+			sink.open_fd(fd);
+			intersect_flags_t flags{members.size()};
+			if(!members.empty()){
+				thread_pool_t pool{threads};
+				std::deque<out_buffer_t> pair_buffers;
+				std::vector<pair_checker_t> checkers;
+				for(unsigned w = 0; w < pool.size(); w++){
+					if(all_pairs)
+						pair_buffers.emplace_back(sink);
+					checkers.push_back({part, method, kernel, flags, all_pairs ? &pair_buffers.back() : nullptr});
+					checkers.back().set_ids(members.data());
+				}
+				search(part, flags, pool, checkers);
+			}
+			if(!all_pairs){
+				out_buffer_t ids{sink};
+				for(size_t k = 0; k < members.size(); k++)
+					if(flags[k])
+						ids.put(members[k]);
+			}
+		}
+
+	public:
+
+		sharded_search(triangle_soup<float> const &soup, int shards): shards_(std::max(1, shards)), first_(soup.size()), last_(soup.size()){
+			size_t n = soup.size();
+			double lo[3] = {INFINITY, INFINITY, INFINITY}, hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+			for(size_t i = 0; i < n; i++)
+				for(int a = 0; a < 3; a++){
+					double centre = ((double)min_of(soup, i, a) + max_of(soup, i, a)) / 2.0;
+					lo[a] = std::min(lo[a], centre);      // NaN drops out
+					hi[a] = std::max(hi[a], centre);
+				}
+			for(int a = 1; a < 3; a++)
+				if(hi[a] - lo[a] > hi[axis_] - lo[axis_])
+					axis_ = a;
+
+			std::vector<double> centres;
+			centres.reserve(n);
+			for(size_t i = 0; i < n; i++){
+				double centre = ((double)min_of(soup, i, axis_) + max_of(soup, i, axis_)) / 2.0;
+				if(!std::isnan(centre))
+					centres.push_back(centre);
+			}
+			std::sort(centres.begin(), centres.end());
+			for(int s = 1; s < shards_ && !centres.empty(); s++)
+				cuts_.push_back(centres[centres.size() * s / shards_]);
+
+			for(size_t i = 0; i < n; i++){
+				double min = min_of(soup, i, axis_), max = max_of(soup, i, axis_);
+				double pad = flt_tolerance + std::max(std::abs(min), std::abs(max)) * std::ldexp(1.0, -20);
+				if(std::isnan(min) || std::isnan(max)){              // can't be placed, goes everywhere
+					first_[i] = 0;
+					last_[i] = shards_ - 1;
+				}
+				else{
+					first_[i] = slab_of(min - pad);
+					last_[i] = slab_of(max + pad);
+				}
+				copies_ += last_[i] - first_[i] + 1;
+			}
+		}
+
+		int shards() const{ return shards_; }
+		int axis() const{ return axis_; }
+		size_t copies() const{ return copies_; }  // triangles in all the shards together
+
+		unsigned threads_per_shard(unsigned threads) const{ // threads 0 - the hardware threads shared out
+			return (threads != 0) ? threads : std::max(1u, std::thread::hardware_concurrency() / shards_);
+		}
+
+		// search(part, flags, pool, checkers) runs the broadphase over the soup of one shard in its process,
+		// threads per shard (see threads_per_shard), ids - output id of every soup index (nullptr - the index)
+		// intersecting ids end up in intersected, pairs are written to output; false if a shard failed
+		template<typename Search>
+		bool run(triangle_soup<float> const &soup, unsigned threads, narrow_t method, tri_batch_kernel_t kernel,
+		         intersect_flags_t &intersected, out_file_t &output, bool all_pairs, const int* ids, Search &&search) const{
+			threads = threads_per_shard(threads);
+			std::fflush(nullptr);                    // nothing buffered gets written twice
+
+			std::vector<pid_t> children;
+			std::vector<pollfd> pipes;
+			bool ok = true;
+			for(int s = 0; s < shards_; s++){
+				int fds[2];
+				if(pipe(fds) != 0){
+					ok = false;
+					break;
+				}
+				pid_t pid = fork();
+				if(pid == 0){
+					for(pollfd const &p : pipes)
+						close(p.fd);
+					close(fds[0]);
+					search_shard(s, fds[1], soup, threads, method, kernel, all_pairs, search);
+					_exit(0);
+				}
+				close(fds[1]);
+				if(pid < 0){
+					close(fds[0]);
+					ok = false;
+					break;
+				}
+				children.push_back(pid);
+				pipes.push_back({fds[0], POLLIN, 0});
+			}
+
+			const size_t record = all_pairs ? 2 * sizeof(uint32_t) : sizeof(uint32_t);
+			std::vector<std::vector<char>> pending(pipes.size());   // partial records
+			std::vector<char> chunk(1 << 16);
+			out_buffer_t pairs{output};
+			size_t running = pipes.size();
+			while(running != 0){
+				if(poll(pipes.data(), pipes.size(), -1) < 0){
+					if(errno == EINTR)
+						continue;
+					ok = false;
+					break;
+				}
+				for(size_t s = 0; s < pipes.size(); s++){
+					if(pipes[s].fd < 0 || pipes[s].revents == 0)
+						continue;
+					ssize_t got = read(pipes[s].fd, chunk.data(), chunk.size());
+					if(got < 0 && errno == EINTR)
+						continue;
+					if(got <= 0){
+						ok = ok && got == 0 && pending[s].empty();
+						close(pipes[s].fd);
+						pipes[s].fd = -1;
+						running--;
+						continue;
+					}
+					std::vector<char> &data = pending[s];
+					data.insert(data.end(), chunk.data(), chunk.data() + got);
+					size_t used = data.size() - data.size() % record;
+					for(size_t pos = 0; pos < used; pos += record){
+						uint32_t v[2];
+						std::memcpy(v, data.data() + pos, record);
+						if(!all_pairs){
+							intersected.set(v[0]);
+							continue;
+						}
+						if(std::max(first_[v[0]], first_[v[1]]) != (int)s)   // found by another shard as well
+							continue;
+						intersected.set(v[0]);
+						intersected.set(v[1]);
+						uint32_t i = (ids != nullptr) ? ids[v[0]] : v[0], j = (ids != nullptr) ? ids[v[1]] : v[1];
+						pairs.put_pair(std::min(i, j), std::max(i, j));
+					}
+					data.erase(data.begin(), data.begin() + used);
+				}
+			}
+
+			for(pid_t pid : children){
+				int status = 0;
+				while(waitpid(pid, &status, 0) < 0 && errno == EINTR);
+				ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+			}
+			return ok;
+		}
+	};
+
+};
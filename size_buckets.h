@@ -0,0 +1,107 @@
+#pragma once
+#include "lingeo3D.h"
+#include "triangle_soup.h"
+#include "sorted_cubes.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace lingeo3D{
+
+/*
+	              SIZE CLASS BUCKETS
+	  sorted_cubes pads every box up to the largest triangle, so one huge triangle makes every x range huge;
+	  here triangles keep their tight boxes and go to buckets by the power of two of their largest extent,
+	  every bucket is sorted by lower x and is padded only by the widest box it holds
+	  a triangle looks for partners in its own bucket (boxes that start after it within its x range)
+	  and in every bigger bucket (boxes that start within that bucket's padding before it), so each pair is found
+	  once, by its smaller triangle, and a huge triangle only costs the queries that can really reach it
+
+*/
+
+template<typename T>
+	class size_buckets{
+
+		std::vector<cube_t<T>> cubes_;     // tight boxes, bucket by bucket, every bucket sorted by lower x
+		std::vector<int> ids_;             // triangle index of cubes_[p]
+		std::vector<int> bucket_start_;    // bucket b holds positions [bucket_start_[b], bucket_start_[b + 1])
+		std::vector<T> pad_;               // widest box of every bucket
+
+		static const int block_ = 1024;
+
+		static int size_class(T extent){
+			int exp = 0;
+			std::frexp(std::max<T>(extent, flt_tolerance), &exp);
+			return exp;
+		}
+
+	public:
+
+		size_buckets(triangle_soup<T> const &soup){
+			int n = soup.size();
+			std::vector<int> classes(n);
+			for(int i = 0; i < n; i++)
+				classes[i] = size_class(std::max(soup.max_x(i) - soup.min_x(i), std::max(soup.max_y(i) - soup.min_y(i), soup.max_z(i) - soup.min_z(i))));
+
+			std::vector<int> order(n);
+			for(int i = 0; i < n; i++)
+				order[i] = i;
+			std::sort(order.begin(), order.end(), [&](int a1, int a2) -> bool {
+				return (classes[a1] != classes[a2]) ? classes[a1] < classes[a2] : soup.min_x(a1) < soup.min_x(a2);
+			});
+
+			cubes_.reserve(n);
+			ids_.reserve(n);
+			for(int p = 0; p < n; p++){
+				int i = order[p];
+				if(p == 0 || classes[i] != classes[order[p - 1]]){
+					bucket_start_.push_back(p);
+					pad_.push_back(0.0);
+				}
+				cubes_.insert(cubes_.end(), {soup, i});
+				ids_.insert(ids_.end(), i);
+				pad_.back() = std::max(pad_.back(), soup.max_x(i) - soup.min_x(i));
+			}
+			bucket_start_.push_back(n);
+		}
+
+		size_t size() const{ return cubes_.size(); }
+		size_t bucket_count() const{ return pad_.size(); }
+
+		size_t work_size() const{ return (cubes_.size() + block_ - 1) / block_; }
+
+		template<typename Fn>
+		void for_each_pair(size_t begin, size_t end, Fn &fn) const{ // fn(i, j) for every candidate pair owned by blocks [begin, end), pairs sharing i come in a row
+			int first = std::min<size_t>(cubes_.size(), begin * block_);
+			int last = std::min<size_t>(cubes_.size(), end * block_);
+			int b = std::upper_bound(bucket_start_.begin(), bucket_start_.end(), first) - bucket_start_.begin() - 1;
+			for(int p = first; p < last; p++){
+				while(bucket_start_[b + 1] <= p)
+					b++;
+				cube_t<T> const &cube = cubes_[p];
+				T right = cube.max_x() + flt_tolerance;
+
+				// own bucket: boxes starting later and not after cube's right side
+				for(int q = p + 1; q < bucket_start_[b + 1] && cubes_[q].min_x() <= right; q++)
+					if(cube.y_interfere(cubes_[q]) && cube.z_interfere(cubes_[q]))
+						fn(ids_[p], ids_[q]);
+
+				// bigger buckets: boxes starting up to their padding before cube
+				for(int c = b + 1; c < pad_.size(); c++){
+					T left = cube.min_x() - pad_[c] - flt_tolerance;
+					auto from = std::lower_bound(cubes_.begin() + bucket_start_[c], cubes_.begin() + bucket_start_[c + 1], left,
+					                             [](cube_t<T> const &other, T x) -> bool {return other.min_x() < x;});
+					for(int q = from - cubes_.begin(); q < bucket_start_[c + 1] && cubes_[q].min_x() <= right; q++)
+						if(cube.interfare(cubes_[q]))
+							fn(ids_[p], ids_[q]);
+				}
+			}
+		}
+
+		template<typename Fn>
+		void for_each_pair(Fn &fn) const{
+			for_each_pair(0, work_size(), fn);
+		}
+	};
+
+};
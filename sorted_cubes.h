@@ -0,0 +1,173 @@
+#pragma once
+#include "lingeo3D.h"
+#include "triangle_soup.h"
+#include "tri_stats.h"
+#include "quantized_box.h"
+#include <vector>
+#include <algorithm>
+
+namespace lingeo3D{
+
+template<typename T>
+class sorted_cubes;
+
+template<typename T>
+class cube_t{ //3d cube
+
+	T x1, y1, z1, x2, y2, z2;
+
+public:
+	cube_t(T min_x = 0.0, T min_y = 0.0, T min_z = 0.0, T max_x = 0.0, T max_y = 0.0, T max_z = 0.0, T cube_size = 0.0){
+		x1 = min_x;
+		y1 = min_y;
+		z1 = min_z;
+
+		x2 = (max_x - min_x < cube_size) ? min_x + cube_size : max_x;
+		y2 = (max_y - min_y < cube_size) ? min_y + cube_size : max_y;
+		z2 = (max_z - min_z < cube_size) ? min_z + cube_size : max_z;
+	}
+
+	cube_t(triangle_soup<T> const &soup, int idx, T cube_size = 0.0): cube_t(soup.min_x(idx), soup.min_y(idx), soup.min_z(idx), soup.max_x(idx), soup.max_y(idx), soup.max_z(idx), cube_size){
+
+	}
+
+	qbox_t quantized(box_quantizer_t<T> const &quantizer) const{
+		return quantizer(x1, y1, z1, x2, y2, z2);
+	}
+
+	bool x_interfere(cube_t<T> const &cube) const{
+		return !(cube.x1 > x2 + flt_tolerance || cube.x2 < x1 - flt_tolerance);
+	}
+
+	bool y_interfere(cube_t<T> const &cube) const{
+		return !(cube.y1 > y2 + flt_tolerance || cube.y2 < y1 - flt_tolerance);
+	}
+
+	bool z_interfere(cube_t<T> const &cube) const{
+		return !(cube.z1 > z2 + flt_tolerance || cube.z2 < z1 - flt_tolerance);
+	}
+
+	bool interfare(cube_t<T> const &cube) const{
+		return x_interfere(cube) && y_interfere(cube) && z_interfere(cube);
+	}
+
+	T min_x() const{ return x1; }
+	T min_y() const{ return y1; }
+	T min_z() const{ return z1; }
+	T max_x() const{ return x2; }
+	T max_y() const{ return y2; }
+	T max_z() const{ return z2; }
+
+	friend class sorted_cubes<T>;
+};
+
+class index_span_t{ // view of consecutive ints owned by someone else, valid while the owner is not changed
+
+	const int* begin_;
+	const int* end_;
+
+public:
+	index_span_t(const int* begin = nullptr, const int* end = nullptr): begin_(begin), end_(end){
+
+	}
+
+	const int* begin() const{ return begin_; }
+	const int* end() const{ return end_; }
+	size_t size() const{ return end_ - begin_; }
+	bool empty() const{ return begin_ == end_; }
+	int operator[](size_t k) const{ return begin_[k]; }
+};
+
+template<typename T>
+class sorted_cubes{
+	std::vector<cube_t<T>> cubes_; //holds cubes of the same size that holding their triangles inside
+
+	std::vector<int> x_sorted_cubes; //holds indexes of cubes_ sorted by x coordinate
+	box_quantizer_t<T> quantizer_;
+	std::vector<qbox_t> x_sorted_boxes; //quantized cubes in the same order: the candidate scan streams through them and reads cubes_ only for survivors
+
+public:
+	sorted_cubes(triangle_soup<T> const &soup){
+
+		T x_size_max = 0.0, y_size_max = 0.0, z_size_max = 0.0;
+		for(int i = 0; i < soup.size(); i++){
+			T x_size = soup.max_x(i) - soup.min_x(i);
+			T y_size = soup.max_y(i) - soup.min_y(i);
+			T z_size = soup.max_z(i) - soup.min_z(i);
+
+			if(x_size > x_size_max) x_size_max = x_size;
+			if(y_size > y_size_max) y_size_max = y_size;
+			if(z_size > z_size_max) z_size_max = z_size;
+		}
+
+		T cube_size = 0.0;                   // cube size must be not less than maximum linear size of triangle appeared in soup to fit all of them
+		
+		if(x_size_max >= y_size_max && x_size_max >= z_size_max)
+			cube_size = x_size_max;
+		else
+			if(y_size_max >= z_size_max && y_size_max >= x_size_max)
+				cube_size = y_size_max;
+			else
+				cube_size = z_size_max;
+
+
+		cubes_.reserve(soup.size());
+		x_sorted_cubes.reserve(soup.size());
+		for(int i = 0; i < soup.size(); i++){
+			cubes_.insert(cubes_.end(), {soup, i, cube_size});
+			x_sorted_cubes.insert(x_sorted_cubes.end(), i);
+		}
+
+		//sorting by x coordinate
+		std::sort(x_sorted_cubes.begin(), x_sorted_cubes.end(), [this](int a1, int a2) -> bool {return cubes_[a1].x1 < cubes_[a2].x1;});
+
+		quantizer_ = box_quantizer_t<T>{soup};
+		x_sorted_boxes.reserve(soup.size());
+		for(int i : x_sorted_cubes)
+			x_sorted_boxes.push_back(cubes_[i].quantized(quantizer_));
+	}
+
+	index_span_t x_range(int index) const{ // cubes interfered by x coordinate with cubes_[index] (itself included), no copies
+
+		//binary search for range of cubes_ interfered by x coordinate with cubes_[index]
+		auto x_range_pair = std::equal_range(x_sorted_cubes.begin(), x_sorted_cubes.end(), index, [this](int a1, int a2) -> bool { return  cubes_[a1].x2 < cubes_[a2].x1;}); 
+
+		return {x_sorted_cubes.data() + (x_range_pair.first - x_sorted_cubes.begin()), x_sorted_cubes.data() + (x_range_pair.second - x_sorted_cubes.begin())};
+	}
+
+	std::vector<int> interfere_x(int index) const{ // the same range copied out
+		index_span_t range = x_range(index);
+		return {range.begin(), range.end()};
+	}
+
+	template<typename Fn>
+	void for_each_candidate(int index, Fn &&fn, bool above_only = false) const{ // fn(j) for every other cube of the x range passing the z and y checks, until fn returns false
+		cube_t<T> const &cube = cubes_[index];                            // above_only - only j > index, to get every pair once
+		qbox_t box = cube.quantized(quantizer_);
+		index_span_t range = x_range(index);
+		const qbox_t* boxes = x_sorted_boxes.data() + (range.begin() - x_sorted_cubes.data());
+		for(size_t k = 0; k < range.size(); k++){
+			int j = range[k];
+			if(j == index || (above_only && j < index))
+				continue;
+			stat_add(STAT_X_CANDIDATES);
+			if(!box.axis_overlap(boxes[k], 2) || !cube.z_interfere(cubes_[j])){
+				stat_add(STAT_Z_REJECTS);
+				continue;
+			}
+			if(!box.axis_overlap(boxes[k], 1) || !cube.y_interfere(cubes_[j])){
+				stat_add(STAT_Y_REJECTS);
+				continue;
+			}
+			if(!fn(j))
+				return;
+		}
+	}
+
+	cube_t<T> const &operator[](int idx) const{
+		return cubes_[idx];
+	}
+
+};
+
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include "triangle_soup.h"
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+namespace lingeo3D{
+
+/*
+	              SPATIAL ORDER
+	  a permutation of the soup that puts triangles near in space near in memory: triangles are sorted by the
+	  Morton (Z-order) or Hilbert code of their centroid, quantized to 21 bits per axis over the scene box,
+	  so the candidates of a triangle mostly sit next to it and the narrowphase reads cache lines the broadphase
+	  has just touched; Hilbert keeps neighbours a little closer (no long jumps between the octants), Morton is cheaper
+	  the searching code works on permuted indices, order[k] gives back the input id of the k-th triangle
+
+*/
+
+	enum reorder_t {REORDER_NONE, REORDER_MORTON, REORDER_HILBERT};
+
+	const int curve_bits = 21;                      // per axis, three of them fill a 64 bit code
+
+	inline uint64_t spread_bits(uint32_t v){ // bit b of v goes to bit 3b
+		uint64_t x = v & 0x1fffff;
+		x = (x | x << 32) & 0x1f00000000ffffULL;
+		x = (x | x << 16) & 0x1f0000ff0000ffULL;
+		x = (x | x << 8) & 0x100f00f00f00f00fULL;
+		x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+		x = (x | x << 2) & 0x1249249249249249ULL;
+		return x;
+	}
+
+	inline uint64_t morton_code(uint32_t x, uint32_t y, uint32_t z){ // x in the highest bit of every triple
+		return spread_bits(x) << 2 | spread_bits(y) << 1 | spread_bits(z);
+	}
+
+	inline uint64_t hilbert_code(uint32_t x, uint32_t y, uint32_t z){ // J. Skilling, Programming the Hilbert curve (2004): axes to transposed index, then interleaved
+		uint32_t v[3] = {x, y, z};
+		const uint32_t top = 1u << (curve_bits - 1);
+		for(uint32_t q = top; q > 1; q >>= 1){           // without branches: the bits are as good as random, mispredictions cost more than the work
+			uint32_t p = q - 1;
+			for(int i = 0; i < 3; i++){
+				uint32_t set = 0u - ((v[i] & q) != 0);
+				uint32_t t = (v[0] ^ v[i]) & p & ~set;   // exchange the low bits with v[0] if the bit is clear
+				v[0] ^= (p & set) | t;                   // invert them if it is set
+				v[i] ^= t;
+			}
+		}
+		v[1] ^= v[0];                                   // gray encode
+		v[2] ^= v[1];
+		uint32_t t = 0;
+		for(uint32_t q = top; q > 1; q >>= 1)
+			t ^= (q - 1) & (0u - ((v[2] & q) != 0));
+		for(int i = 0; i < 3; i++)
+			v[i] ^= t;
+		return morton_code(v[0], v[1], v[2]);
+	}
+
+template<typename T>
+	std::vector<int> spatial_order(triangle_soup<T> const &soup, reorder_t curve){ // order[k] - soup index of the k-th triangle along the curve, ties keep the input order
+		size_t n = soup.size();
+		std::vector<int> order(n);
+		for(size_t i = 0; i < n; i++)
+			order[i] = i;
+		if(curve == REORDER_NONE || n == 0)
+			return order;
+
+		double lo[3] = {INFINITY, INFINITY, INFINITY}, hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+		std::vector<double> centre(3 * n);
+		for(size_t i = 0; i < n; i++){
+			centre[3 * i] = ((double)soup.min_x(i) + soup.max_x(i)) / 2.0; // box centre, as good as the centroid for ordering
+			centre[3 * i + 1] = ((double)soup.min_y(i) + soup.max_y(i)) / 2.0;
+			centre[3 * i + 2] = ((double)soup.min_z(i) + soup.max_z(i)) / 2.0;
+			for(int a = 0; a < 3; a++){
+				lo[a] = std::min(lo[a], centre[3 * i + a]);    // NaN centres drop out here
+				hi[a] = std::max(hi[a], centre[3 * i + a]);
+			}
+		}
+
+		const double cells = (double)((1u << curve_bits) - 1);
+		std::vector<std::pair<uint64_t, int>> keys(n);
+		for(size_t i = 0; i < n; i++){
+			uint32_t q[3];
+			for(int a = 0; a < 3; a++){
+				double t = (hi[a] > lo[a]) ? (centre[3 * i + a] - lo[a]) / (hi[a] - lo[a]) : 0.0;
+				q[a] = (t >= 0.0) ? (uint32_t)(std::min(t, 1.0) * cells) : 0;
+			}
+			keys[i] = {curve == REORDER_HILBERT ? hilbert_code(q[0], q[1], q[2]) : morton_code(q[0], q[1], q[2]), (int)i};
+		}
+		std::sort(keys.begin(), keys.end());
+		for(size_t k = 0; k < n; k++)
+			order[k] = keys[k].second;
+		return order;
+	}
+
+};
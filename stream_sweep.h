@@ -0,0 +1,275 @@
+#pragma once
+#include "lingeo3D.h"
+#include "triangle_soup.h"
+#include "sorted_cubes.h"
+#include "narrowphase.h"
+#include "external_sort.h"
+#include "thread_pool.h"
+#include "tri_io.h"
+#include "tri_stats.h"
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <algorithm>
+
+namespace lingeo3D{
+
+/*
+	              OUT-OF-CORE SWEEP
+	  finds the intersecting triangles of an input bigger than memory: add() sends every triangle with its id
+	  through an external sort by the min x of its box, run() reads them back in that order a block at a time
+	  and keeps a window of the triangles a later one can still reach in x (same cube_t overlap with flt_tolerance)
+	  every block is first put into the window and then checked against the window triangles in front of it,
+	  a (y, z) grid of cells about twice the mean triangle extent is rebuilt over the window for every block
+	  a triangle leaves the window once the sweep is past its max x, its id is final then and goes to a second
+	  external sort, so the ids come out in ascending order just like in memory; in all pairs mode the pairs
+	  are written as they are found
+	  memory: half of mem_limit for the sort, the window and the ids get the rest; a window that outgrows
+	  its share (a lot of triangles long in x) still works, window_bytes() tells by how much
+	  triangles with NaN coordinates can't be ordered and are left out
+
+*/
+
+	struct stream_tri_t{ // one triangle on its way through the external sort
+		float min_x;
+		int id;
+		float coords[9];
+	};
+
+	struct stream_tri_less_t{
+		bool operator()(stream_tri_t const &a, stream_tri_t const &b) const{
+			return a.min_x < b.min_x || (a.min_x == b.min_x && a.id < b.id);
+		}
+	};
+
+	class stream_sweep{
+
+		static constexpr size_t min_block = 4096;   // triangles read from the sort at a time, at least
+		static constexpr int unit_size = 64;         // block triangles per pool unit
+		static constexpr int64_t max_query = 64;     // query boxes covering more cells scan the window instead
+
+		size_t mem_limit_;
+		narrow_t method_;
+		tri_batch_kernel_t kernel_;
+		external_sorter<stream_tri_t, stream_tri_less_t> sorter_;
+		double extent_sum_ = 0.0;               // largest y or z extents of the triangles, for the cell size
+		size_t skipped_ = 0;
+		size_t hits_ = 0;
+
+		triangle_soup<float> window_;           // the window in sweep order, with the input ids and final flags
+		std::vector<int> ids_;
+		std::vector<char> hit_;
+		size_t window_peak_ = 0;
+
+		float cell_ = 1.0;
+		std::vector<std::pair<uint64_t, int>> cells_;   // (cell of the low y z corner, window position), sorted
+		std::vector<int> big_;                           // window positions wider than a cell in y or z, ascending
+
+		int64_t cell_of(float v) const{
+			double c = std::floor((double)v / cell_);
+			return (int64_t)std::max(-1e9, std::min(1e9, c));
+		}
+
+		static uint64_t cell_key(int64_t cy, int64_t cz){
+			return ((uint64_t)(cy + (1LL << 31)) << 32) | (uint64_t)(cz + (1LL << 31));
+		}
+
+		size_t entry_bytes() const{ // window memory per triangle: soup, id, flag, grid entry, shared flag
+			return 15 * sizeof(float) + sizeof(int) + 2 + sizeof(cells_[0]) + (window_.planes_cached() ? sizeof(tri_plane_t<float>) : 0);
+		}
+
+		template<typename Sink>
+		void evict(float front_x, Sink &&sink){ // drops the triangles the sweep is past, sink(window position) for each
+			size_t keep = 0;
+			for(size_t k = 0; k < ids_.size(); k++){
+				if(window_.max_x(k) < front_x - flt_tolerance){
+					sink(k);
+					continue;
+				}
+				if(keep != k){
+					window_.set(keep, window_.triangle(k));
+					ids_[keep] = ids_[k];
+					hit_[keep] = hit_[k];
+				}
+				keep++;
+			}
+			window_.resize(keep);
+			ids_.resize(keep);
+			hit_.resize(keep);
+		}
+
+		void append(std::vector<stream_tri_t> const &block){
+			size_t first = ids_.size();
+			window_.resize(first + block.size());
+			for(size_t k = 0; k < block.size(); k++){
+				const float* c = block[k].coords;
+				window_.set(first + k, point_t<float>{c[0], c[1], c[2]}, point_t<float>{c[3], c[4], c[5]}, point_t<float>{c[6], c[7], c[8]});
+				ids_.push_back(block[k].id);
+				hit_.push_back(0);
+			}
+		}
+
+		void build_grid(){
+			cells_.clear();
+			big_.clear();
+			for(size_t k = 0; k < ids_.size(); k++){
+				if(window_.max_y(k) - window_.min_y(k) > cell_ || window_.max_z(k) - window_.min_z(k) > cell_)
+					big_.push_back(k);
+				else
+					cells_.push_back({cell_key(cell_of(window_.min_y(k)), cell_of(window_.min_z(k))), (int)k});
+			}
+			std::sort(cells_.begin(), cells_.end());
+		}
+
+		template<typename Visit>
+		void for_each_before(int p, Visit &&visit) const{ // visit(q) for the window triangles q < p whose box may touch the box of p
+			int64_t y0 = cell_of(window_.min_y(p) - flt_tolerance - cell_), y1 = cell_of(window_.max_y(p) + flt_tolerance);
+			int64_t z0 = cell_of(window_.min_z(p) - flt_tolerance - cell_), z1 = cell_of(window_.max_z(p) + flt_tolerance);
+			if((y1 - y0 + 1) * (z1 - z0 + 1) > max_query){
+				for(int q = 0; q < p; q++)
+					visit(q);
+				return;
+			}
+			for(int64_t cy = y0; cy <= y1; cy++)
+				for(int64_t cz = z0; cz <= z1; cz++){
+					uint64_t key = cell_key(cy, cz);
+					auto it = std::lower_bound(cells_.begin(), cells_.end(), std::make_pair(key, INT_MIN));
+					for(; it != cells_.end() && it->first == key && it->second < p; ++it)
+						visit(it->second);
+				}
+			for(int q : big_){
+				if(q >= p)
+					break;
+				visit(q);
+			}
+		}
+
+		void check_block(size_t first, thread_pool_t &pool, std::deque<out_buffer_t> &pair_buffers){
+			size_t n = ids_.size();
+			intersect_flags_t flags{n};
+			for(size_t k = 0; k < n; k++)
+				if(hit_[k])
+					flags.set(k);
+
+			std::vector<pair_checker_t> checkers;
+			for(unsigned w = 0; w < pool.size(); w++){
+				checkers.push_back({window_, method_, kernel_, flags, pair_buffers.empty() ? nullptr : &pair_buffers[w]});
+				checkers.back().set_ids(ids_.data());
+			}
+
+			size_t units = (n - first + unit_size - 1) / unit_size;
+			pool.run(units, [&](unsigned worker, size_t unit){
+				pair_checker_t &checker = checkers[worker];
+				size_t end = std::min(n, first + (unit + 1) * unit_size);
+				for(size_t p = first + unit * unit_size; p < end; p++){
+					cube_t<float> box{window_, (int)p};
+					for_each_before(p, [&](int q){
+						stat_add(STAT_X_CANDIDATES);
+						if(box.interfare(cube_t<float>{window_, q}))
+							checker(p, q);
+					});
+					checker.flush();
+				}
+			});
+
+			for(size_t k = 0; k < n; k++)
+				hit_[k] = flags[k];
+		}
+
+	public:
+
+		stream_sweep(size_t mem_limit, narrow_t method, tri_batch_kernel_t kernel):
+			mem_limit_(mem_limit), method_(method), kernel_(kernel), sorter_(mem_limit / 2){
+
+		}
+
+		size_t size() const{ return sorter_.size(); }
+		size_t skipped() const{ return skipped_; }
+		size_t intersected() const{ return hits_; }
+		size_t runs() const{ return sorter_.runs(); }
+		size_t window_peak() const{ return window_peak_; }
+		size_t window_bytes() const{ return window_peak_ * entry_bytes(); }
+		size_t window_budget() const{ return mem_limit_ / 2 - mem_limit_ / 16; }
+
+		bool add(int id, const float* coords){ // false once the sort can't write its runs
+			stream_tri_t rec;
+			rec.id = id;
+			for(int k = 0; k < 9; k++){
+				if(std::isnan(coords[k])){
+					skipped_++;
+					return true;
+				}
+				rec.coords[k] = coords[k];
+			}
+			rec.min_x = std::min(coords[0], std::min(coords[3], coords[6]));
+			float ey = std::max(coords[1], std::max(coords[4], coords[7])) - std::min(coords[1], std::min(coords[4], coords[7]));
+			float ez = std::max(coords[2], std::max(coords[5], coords[8])) - std::min(coords[2], std::min(coords[5], coords[8]));
+			extent_sum_ += std::max(ey, ez);
+			return sorter_.push(rec);
+		}
+
+		bool sort(){ // after the last add()
+			return sorter_.finish();
+		}
+
+		bool run(thread_pool_t &pool, out_file_t &output, bool all_pairs){ // after sort(), writes the ids or the pairs, false on a disk error
+			size_t count = sorter_.size();
+			if(count != 0 && extent_sum_ > 0.0)
+				cell_ = std::max<double>(2.0 * extent_sum_ / count, 4.0 * flt_tolerance);
+			if(method_ == NARROW_PLANES)
+				window_.cache_planes();
+
+			external_sorter<int> hits{mem_limit_ / 16};
+			bool ok = true;
+			auto report = [&](size_t k){
+				if(!hit_[k])
+					return;
+				hits_++;
+				if(!all_pairs && !hits.push(ids_[k]))
+					ok = false;
+			};
+
+			std::deque<out_buffer_t> pair_buffers;
+			if(all_pairs)
+				for(unsigned w = 0; w < pool.size(); w++)
+					pair_buffers.emplace_back(output);
+
+			stat_phase_t search{"search"};
+			std::vector<stream_tri_t> block;
+			stream_tri_t rec;
+			bool more = sorter_.next(rec);
+			while(more && ok){
+				size_t block_size = std::max(min_block, ids_.size() / 2);
+				block.clear();
+				for(; more && block.size() < block_size; more = sorter_.next(rec))
+					block.push_back(rec);
+				evict(block.front().min_x, report);
+				size_t first = ids_.size();
+				append(block);
+				window_peak_ = std::max(window_peak_, ids_.size());
+				build_grid();
+				check_block(first, pool, pair_buffers);
+			}
+			if(!ok)
+				return false;
+			for(size_t k = 0; k < ids_.size(); k++)
+				report(k);
+			search.stop();
+
+			stat_phase_t write{"output"};
+			pair_buffers.clear();
+			if(!all_pairs){
+				if(!hits.finish())
+					return false;
+				out_buffer_t buffer{output};
+				int id;
+				while(hits.next(id))
+					buffer.put(id);
+			}
+			return true;
+		}
+	};
+
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include "lingeo3D.h"
+#include "triangle_soup.h"
+#include "sorted_cubes.h"
+#include "tri_stats.h"
+#include <vector>
+#include <algorithm>
+
+namespace lingeo3D{
+
+/*
+	              SWEEP AND PRUNE
+	  the tight boxes are sorted by their lower x once, then swept from left to right keeping the list of boxes
+	  that are still open at the current x: every box that starts is checked (y/z inline) against the open ones only,
+	  so each candidate pair comes out exactly once and the work is linear in the number of x-overlapping pairs
+
+	  the sweep is cut into blocks of sweep positions (work units), a block rebuilds the boxes open at its start
+	  from the sorted order, so blocks can be swept in any order or concurrently
+
+*/
+
+template<typename T>
+	class sweep_prune{
+
+		std::vector<cube_t<T>> cubes_;   // tight boxes in sweep order
+		std::vector<int> ids_;           // triangle index of cubes_[p]
+		T max_x_size_ = 0.0;             // widest box: nothing that starts further left than this can still be open
+
+		static const int block_ = 1024;
+
+	public:
+
+		sweep_prune(triangle_soup<T> const &soup){
+			std::vector<int> order(soup.size());
+			for(int i = 0; i < order.size(); i++)
+				order[i] = i;
+			std::sort(order.begin(), order.end(), [&soup](int a1, int a2) -> bool {return soup.min_x(a1) < soup.min_x(a2);});
+
+			cubes_.reserve(order.size());
+			ids_.reserve(order.size());
+			for(int i = 0; i < order.size(); i++){
+				cubes_.insert(cubes_.end(), {soup, order[i]});
+				ids_.insert(ids_.end(), order[i]);
+				max_x_size_ = std::max(max_x_size_, soup.max_x(order[i]) - soup.min_x(order[i]));
+			}
+		}
+
+		size_t size() const{ return cubes_.size(); }
+
+		size_t work_size() const{ return (cubes_.size() + block_ - 1) / block_; }
+
+		template<typename Fn>
+		void for_each_pair(size_t begin, size_t end, Fn &fn) const{ // fn(i, j) for every candidate pair owned by blocks [begin, end), pairs sharing i come in a row
+			std::vector<int> active;      // sweep positions of the open boxes
+			for(size_t unit = begin; unit < end; unit++){
+				int first = unit * block_;
+				int last = std::min<int>(cubes_.size(), first + block_);
+
+				// boxes opened before the block that are still open at its first position
+				active.clear();
+				T start_x = cubes_[first].min_x() - max_x_size_ - flt_tolerance;
+				int q = std::lower_bound(cubes_.begin(), cubes_.begin() + first, start_x, [](cube_t<T> const &cube, T x) -> bool {return cube.min_x() < x;}) - cubes_.begin();
+				for(; q < first; q++)
+					if(cubes_[q].max_x() >= cubes_[first].min_x() - flt_tolerance)
+						active.push_back(q);
+
+				for(int p = first; p < last; p++){
+					cube_t<T> const &cube = cubes_[p];
+					int kept = 0;
+					for(int k = 0; k < active.size(); k++){
+						cube_t<T> const &open = cubes_[active[k]];
+						if(open.max_x() < cube.min_x() - flt_tolerance)   // closed for good, the sweep only moves right
+							continue;
+						active[kept++] = active[k];
+						stat_add(STAT_X_CANDIDATES);
+						if(!cube.z_interfere(open))
+							stat_add(STAT_Z_REJECTS);
+						else if(!cube.y_interfere(open))
+							stat_add(STAT_Y_REJECTS);
+						else
+							fn(ids_[p], ids_[active[k]]);
+					}
+					active.resize(kept);
+					active.push_back(p);
+				}
+			}
+		}
+
+		template<typename Fn>
+		void for_each_pair(Fn &fn) const{
+			for_each_pair(0, work_size(), fn);
+		}
+	};
+
+};
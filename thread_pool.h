@@ -0,0 +1,159 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+namespace lingeo3D{
+
+/*
+	              WORK STEALING THREAD POOL
+	  run(units, fn) calls fn(worker, unit) once for every unit in [0, units) and returns when all of them are done,
+	  the calling thread works as worker 0 and the other workers sleep between runs
+	  every worker starts with an even slice of the units and takes them from the front of its slice one by one,
+	  a worker whose slice is empty steals the back half of somebody else's: units of very different cost
+	  (crowded and empty parts of the scene) still keep all the workers busy
+	  a slice is one 64 bit word (first unit, end unit) updated by compare-and-swap only, so taking and stealing never lock,
+	  more than UINT32_MAX units are done in several runs one after another
+
+*/
+
+	class thread_pool_t{
+
+		struct alignas(64) slice_t{             // one cache line per worker, owners and thieves hit different lines
+			std::atomic<uint64_t> span{0};
+		};
+
+		static uint64_t pack(uint64_t first, uint64_t end){ return (end << 32) | first; }
+		static uint32_t first_of(uint64_t span){ return (uint32_t)span; }
+		static uint32_t end_of(uint64_t span){ return (uint32_t)(span >> 32); }
+
+		unsigned size_;
+		std::unique_ptr<slice_t[]> slices_;
+		std::vector<std::thread> threads_;
+
+		std::mutex mutex_;
+		std::condition_variable wake_, done_;
+		unsigned generation_ = 0;               // bumped by every run() to wake the workers
+		unsigned busy_ = 0;                     // workers still inside the current run
+		bool stop_ = false;
+		std::function<void(unsigned, size_t)> job_;
+
+		bool take(unsigned w, size_t &unit){
+			uint64_t span = slices_[w].span.load(std::memory_order_relaxed);
+			while(first_of(span) < end_of(span))
+				if(slices_[w].span.compare_exchange_weak(span, pack(first_of(span) + 1, end_of(span)))){
+					unit = first_of(span);
+					return true;
+				}
+			return false;
+		}
+
+		bool steal(unsigned w, size_t &unit){
+			for(unsigned k = 1; k < size_; k++){
+				slice_t &victim = slices_[(w + k) % size_];
+				uint64_t span = victim.span.load(std::memory_order_relaxed);
+				while(first_of(span) < end_of(span)){
+					uint32_t mid = first_of(span) + (end_of(span) - first_of(span)) / 2;
+					if(victim.span.compare_exchange_weak(span, pack(first_of(span), mid))){
+						slices_[w].span.store(pack(mid + 1, end_of(span)));
+						unit = mid;
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		void work(unsigned w){
+			size_t unit;
+			while(take(w, unit) || steal(w, unit))
+				job_(w, unit);
+		}
+
+		void worker_loop(unsigned w){
+			unsigned seen = 0;
+			for(;;){
+				{
+					std::unique_lock<std::mutex> lock{mutex_};
+					wake_.wait(lock, [&]{ return stop_ || generation_ != seen; });
+					if(stop_)
+						return;
+					seen = generation_;
+				}
+				work(w);
+				std::lock_guard<std::mutex> lock{mutex_};
+				if(--busy_ == 0)
+					done_.notify_one();
+			}
+		}
+
+		template<typename Fn>
+		void run_slices(size_t units, Fn &fn){ // run() of at most UINT32_MAX units
+			for(unsigned w = 0; w < size_; w++)
+				slices_[w].span.store(pack(units * w / size_, units * (w + 1) / size_), std::memory_order_relaxed);
+			{
+				std::lock_guard<std::mutex> lock{mutex_};
+				job_ = std::ref(fn);
+				busy_ = size_ - 1;
+				generation_++;
+			}
+			wake_.notify_all();
+
+			work(0);
+
+			std::unique_lock<std::mutex> lock{mutex_};
+			done_.wait(lock, [&]{ return busy_ == 0; });
+			job_ = nullptr;
+		}
+
+	public:
+
+		explicit thread_pool_t(unsigned threads = 0){ // threads 0 - as many as the hardware has
+			if(threads == 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+			size_ = threads;
+			slices_.reset(new slice_t[size_]);
+			for(unsigned w = 1; w < size_; w++)
+				threads_.emplace_back(&thread_pool_t::worker_loop, this, w);
+		}
+
+		thread_pool_t(thread_pool_t const &) = delete;
+		thread_pool_t &operator=(thread_pool_t const &) = delete;
+
+		~thread_pool_t(){
+			{
+				std::lock_guard<std::mutex> lock{mutex_};
+				stop_ = true;
+			}
+			wake_.notify_all();
+			for(auto &thread : threads_)
+				thread.join();
+		}
+
+		unsigned size() const{ return size_; }
+
+		template<typename Fn>
+		void run(size_t units, Fn &&fn){ // fn(worker, unit) for every unit in [0, units), worker < size()
+			if(size_ == 1){
+				for(size_t unit = 0; unit < units; unit++)
+					fn(0u, unit);
+				return;
+			}
+			if(units <= UINT32_MAX){
+				run_slices(units, fn);
+				return;
+			}
+			for(size_t base = 0; base < units; base += UINT32_MAX){   // slices are 32 bit, more units go in several runs
+				auto shifted = [&](unsigned worker, size_t unit){ fn(worker, base + unit); };
+				run_slices(std::min<size_t>(units - base, UINT32_MAX), shifted);
+			}
+		}
+	};
+
+};
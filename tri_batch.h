@@ -0,0 +1,128 @@
+#pragma once
+#include "lingeo3D.h"
+#include "triangle_soup.h"
+#include <cstring>
+
+namespace lingeo3D{
+
+/*
+	              BATCHED NARROWPHASE
+	  checks one triangle against up to tri_batch_max candidates at once: every candidate takes one float lane
+	  and triangle_t::intersect_by_planes is evaluated for all lanes with the same arithmetic (so the answers are the same),
+	  the result is a bit mask of lanes that intersect the triangle
+	  lanes are 4 (SSE), 8 (AVX2) or 16 (AVX-512) wide, the widest one the CPU supports is picked at runtime,
+	  coplanar pairs (rare) and non-x86 machines go through the scalar triangle_t code
+
+*/
+
+	const int tri_batch_max = 16;
+
+	struct alignas(64) tri_batch_t{ // candidate k is stored in lane k
+		float x[3][tri_batch_max], y[3][tri_batch_max], z[3][tri_batch_max];
+		int ids[tri_batch_max];
+		int size = 0;
+
+		tri_batch_t(){
+			std::memset(x, 0, sizeof(x));
+			std::memset(y, 0, sizeof(y));
+			std::memset(z, 0, sizeof(z));
+		}
+
+		void clear(){ size = 0; }
+		bool full() const{ return size == tri_batch_max; }
+		bool empty() const{ return size == 0; }
+
+		void add(triangle_soup<float> const &soup, int id){
+			for(int k = 0; k < 3; k++){
+				x[k][size] = soup.x(k)[id];
+				y[k][size] = soup.y(k)[id];
+				z[k][size] = soup.z(k)[id];
+			}
+			ids[size++] = id;
+		}
+
+		triangle_t<float> triangle(int lane) const{
+			return triangle_t<float>{{x[0][lane], y[0][lane], z[0][lane]}, {x[1][lane], y[1][lane], z[1][lane]}, {x[2][lane], y[2][lane], z[2][lane]}};
+		}
+	};
+
+	typedef unsigned (*tri_batch_kernel_t)(triangle_t<float> const &tri, tri_batch_t const &batch);
+
+	inline unsigned tri_batch_scalar(triangle_t<float> const &tri, tri_batch_t const &batch){
+		unsigned hits = 0;
+		for(int lane = 0; lane < batch.size; lane++)
+			if(tri.intersect_by_planes(batch.triangle(lane)))
+				hits |= 1u << lane;
+		return hits;
+	}
+
+
+template<int W>
+	struct tri_lanes_t;              // kernel over W float lanes, one specialization per instruction set is stamped out of tri_batch_lanes.h
+
+#if defined(__x86_64__) || defined(__i386__)
+
+	// GCC lowers vector code to the instruction set of the function that holds it, so every width is compiled under its own target
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#pragma GCC optimize("fp-contract=off")
+#define TRI_LANES 4
+#include "tri_batch_lanes.h"
+#undef TRI_LANES
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#pragma GCC optimize("fp-contract=off")
+#define TRI_LANES 8
+#include "tri_batch_lanes.h"
+#undef TRI_LANES
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#pragma GCC optimize("fp-contract=off")
+#define TRI_LANES 16
+#include "tri_batch_lanes.h"
+#undef TRI_LANES
+#pragma GCC pop_options
+
+	inline unsigned tri_batch_sse(triangle_t<float> const &tri, tri_batch_t const &batch){
+		return tri_lanes_t<4>::run(tri, batch);
+	}
+
+	inline unsigned tri_batch_avx2(triangle_t<float> const &tri, tri_batch_t const &batch){
+		return tri_lanes_t<8>::run(tri, batch);
+	}
+
+	inline unsigned tri_batch_avx512(triangle_t<float> const &tri, tri_batch_t const &batch){
+		return tri_lanes_t<16>::run(tri, batch);
+	}
+
+#endif
+
+	inline tri_batch_kernel_t tri_batch_kernel(const char* name = nullptr){ // the widest kernel the CPU runs, or the one called name ("scalar", "sse", "avx2", "avx512") if supported
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_cpu_init();
+		bool any = (name == nullptr);
+		if((any || std::strcmp(name, "avx512") == 0) && __builtin_cpu_supports("avx512f"))
+			return tri_batch_avx512;
+		if((any || std::strcmp(name, "avx2") == 0) && __builtin_cpu_supports("avx2"))
+			return tri_batch_avx2;
+		if((any || std::strcmp(name, "sse") == 0) && __builtin_cpu_supports("sse2"))
+			return tri_batch_sse;
+#endif
+		return tri_batch_scalar;
+	}
+
+	inline const char* tri_batch_kernel_name(tri_batch_kernel_t kernel){
+#if defined(__x86_64__) || defined(__i386__)
+		if(kernel == tri_batch_avx512) return "avx512";
+		if(kernel == tri_batch_avx2) return "avx2";
+		if(kernel == tri_batch_sse) return "sse";
+#endif
+		return "scalar";
+	}
+
+};
@@ -0,0 +1,138 @@
+// no include guard on purpose: tri_batch.h includes this file once per instruction set,
+// with TRI_LANES set to the number of float lanes and the matching "#pragma GCC target" in effect
+
+template<>
+	struct tri_lanes_t<TRI_LANES>{ // triangle_t::intersect_by_planes for TRI_LANES candidates at once, in GCC vector extensions
+		typedef float vf __attribute__((vector_size(TRI_LANES * sizeof(float))));
+		typedef int vi __attribute__((vector_size(TRI_LANES * sizeof(int))));
+
+		static void load(vf &v, const float* ptr){
+			std::memcpy(&v, ptr, sizeof(v));
+		}
+
+		static vf abs(vf const &v){
+			return (v < 0.0f) ? -v : v;
+		}
+
+		static void interval(vf const &p0, vf const &p1, vf const &p2, vf const &d0, vf const &d1, vf const &d2, vf &lo, vf &hi){ // plane_interval() for every lane
+			vi iso2 = (d0 * d1 > 0.0f);
+			vi iso1 = ~iso2 & (d0 * d2 > 0.0f);
+			vi iso0 = ~iso2 & ~iso1 & ((d1 * d2 > 0.0f) | (d0 != 0.0f));
+			iso1 = iso1 | (~iso2 & ~iso1 & ~iso0 & (d1 != 0.0f));
+
+			vf p_iso = iso0 ? p0 : (iso1 ? p1 : p2);
+			vf d_iso = iso0 ? d0 : (iso1 ? d1 : d2);
+			vf p_first = iso0 ? p1 : p0;
+			vf d_first = iso0 ? d1 : d0;
+			vf p_second = (~iso0 & ~iso1) ? p1 : p2;
+			vf d_second = (~iso0 & ~iso1) ? d1 : d2;
+
+			vf t0 = p_iso + (p_first - p_iso) * d_iso / (d_iso - d_first);
+			vf t1 = p_iso + (p_second - p_iso) * d_iso / (d_iso - d_second);
+			lo = (t0 > t1) ? t1 : t0;
+			hi = (t0 > t1) ? t0 : t1;
+		}
+
+		static unsigned run(triangle_t<float> const &tri, tri_batch_t const &batch){
+			const int W = TRI_LANES;
+
+			if(!tri.valid())
+				return 0;
+
+			point_t<float> norm1 = tri.normal();
+			float d1 = -norm1.scalar_prod(tri[0]);
+			float eps1 = flt_tolerance * flt_tolerance * norm1.scalar_prod(norm1);
+			const float tol2 = flt_tolerance * flt_tolerance;
+			float side1 = 0.0f;                                    // longest side of tri, squared
+			for(int k = 0; k < 3; k++){
+				point_t<float> side = tri[k == 2 ? 0 : k + 1] - tri[k];
+				side1 = std::max(side1, side.scalar_prod(side));
+			}
+			float height1 = norm1.scalar_prod(norm1) / side1;     // squared, as in nearly_parallel()
+			float inv1 = 1.0f / std::sqrt(norm1.scalar_prod(norm1));
+
+			unsigned hits = 0, fallback = 0;
+			for(int g = 0; g < batch.size; g += W){
+				vf bx[3], by[3], bz[3];
+				vi valid = (vi{} == 0);
+				for(int k = 0; k < 3; k++){
+					load(bx[k], batch.x[k] + g);
+					load(by[k], batch.y[k] + g);
+					load(bz[k], batch.z[k] + g);
+					valid = valid & (bx[k] == bx[k]) & (by[k] == by[k]) & (bz[k] == bz[k]);
+				}
+
+				// plane of the candidates and signed distances of tri's vertices to it
+				vf e0x = bx[1] - bx[0], e0y = by[1] - by[0], e0z = bz[1] - bz[0];
+				vf e1x = bx[2] - bx[0], e1y = by[2] - by[0], e1z = bz[2] - bz[0];
+				vf n2x = e0y * e1z - e1y * e0z;
+				vf n2y = -e0x * e1z + e1x * e0z;
+				vf n2z = e0x * e1y - e1x * e0y;
+				vf d2 = -(n2x * bx[0] + n2y * by[0] + n2z * bz[0]);
+				vf eps2 = tol2 * (n2x * n2x + n2y * n2y + n2z * n2z);
+
+				vf da[3];
+				for(int k = 0; k < 3; k++){
+					da[k] = n2x * tri[k].x_ + n2y * tri[k].y_ + n2z * tri[k].z_ + d2;
+					da[k] = (da[k] * da[k] < eps2) ? 0.0f : da[k];
+				}
+				vi reject = (da[0] * da[1] > 0.0f) & (da[0] * da[2] > 0.0f);
+
+				// signed distances of the candidates' vertices to the plane of tri
+				vf db[3];
+				for(int k = 0; k < 3; k++){
+					db[k] = norm1.x_ * bx[k] + norm1.y_ * by[k] + norm1.z_ * bz[k] + d1;
+					db[k] = (db[k] * db[k] < eps1) ? 0.0f : db[k];
+				}
+				reject = reject | ((db[0] * db[1] > 0.0f) & (db[0] * db[2] > 0.0f));
+
+				vi coplanar = ((da[0] == 0.0f) & (da[1] == 0.0f) & (da[2] == 0.0f)) | ((db[0] == 0.0f) & (db[1] == 0.0f) & (db[2] == 0.0f));
+
+				// projections on the largest component of the planes' common line
+				vf ax = abs(norm1.y_ * n2z - n2y * norm1.z_);
+				vf ay = abs(-norm1.x_ * n2z + n2x * norm1.z_);
+				vf az = abs(norm1.x_ * n2y - n2x * norm1.y_);
+				vi sel_x = (ax >= ay) & (ax >= az);
+				vi sel_y = ~sel_x & (ay >= az);
+
+				// nearly parallel planes go to the scalar test as coplanar pairs do, see nearly_parallel()
+				vf side2 = e0x * e0x + e0y * e0y + e0z * e0z;
+				vf side = e1x * e1x + e1y * e1y + e1z * e1z;
+				side2 = (side > side2) ? side : side2;
+				vf ex = bx[2] - bx[1], ey = by[2] - by[1], ez = bz[2] - bz[1];
+				side = ex * ex + ey * ey + ez * ez;
+				side2 = (side > side2) ? side : side2;
+				vf norm2 = n2x * n2x + n2y * n2y + n2z * n2z;
+				vf height2 = norm2 / side2;
+				height2 = (height2 > height1) ? (vf{} + height1) : height2;
+				vf cx = ax * inv1, cy = ay * inv1, cz = az * inv1;
+				vf sine2 = (cx * cx + cy * cy + cz * cz) / norm2;
+				coplanar = coplanar | (sine2 * height2 <= 4.0f * tol2);
+
+				vf pa[3], pb[3];
+				for(int k = 0; k < 3; k++){
+					pa[k] = sel_x ? (vf{} + tri[k].x_) : (sel_y ? (vf{} + tri[k].y_) : (vf{} + tri[k].z_));
+					pb[k] = sel_x ? bx[k] : (sel_y ? by[k] : bz[k]);
+				}
+
+				vf a0, a1, b0, b1;
+				interval(pa[0], pa[1], pa[2], da[0], da[1], da[2], a0, a1);
+				interval(pb[0], pb[1], pb[2], db[0], db[1], db[2], b0, b1);
+
+				vi live = valid & ~reject;
+				vi hit = live & ~coplanar & ~((a1 < b0) | (b1 < a0));
+				vi slow = live & coplanar;
+
+				for(int lane = 0; lane < W && g + lane < batch.size; lane++){
+					if(hit[lane]) hits |= 1u << (g + lane);
+					if(slow[lane]) fallback |= 1u << (g + lane);
+				}
+			}
+
+			for(int lane = 0; fallback != 0; lane++, fallback >>= 1)
+				if((fallback & 1) && tri.intersect_by_planes(batch.triangle(lane)))
+					hits |= 1u << lane;
+
+			return hits;
+		}
+	};
@@ -0,0 +1,822 @@
+#pragma once
+#include "lingeo3D.h"
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <charconv>
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace lingeo3D{
+
+/*
+	              BINARY TRIANGLE CONTAINER
+	  [tri_header_t : 32 bytes][count * 9 scalars: x y z of 1st, 2nd and 3rd vertex, triangle by triangle]
+	  scalars are float or double (see tri_header_t::scalar) in the byte order of the machine that wrote the file,
+	  so the payload of a float file can be used straight from the mapping without any copy
+
+*/
+
+	const char tri_magic[4] = {'T', 'R', 'I', '3'};
+	const uint32_t tri_version = 1;
+
+	enum tri_scalar_t : uint32_t {TRI_FLOAT = 4, TRI_DOUBLE = 8};
+	enum tri_flags_t : uint32_t {TRI_BIG_ENDIAN = 1};     // set if the payload was written on a big-endian machine
+
+	struct tri_header_t{
+		char magic[4];
+		uint32_t version;
+		uint64_t count;      // number of triangles
+		uint32_t scalar;     // TRI_FLOAT or TRI_DOUBLE
+		uint32_t flags;      // tri_flags_t
+		uint64_t reserved;
+	};
+
+	static_assert(sizeof(tri_header_t) == 32, "tri_header_t must stay 32 bytes");
+
+	inline uint32_t native_tri_flags(){
+		const uint16_t probe = 1;
+		return (*reinterpret_cast<const unsigned char*>(&probe) == 1) ? 0u : (uint32_t)TRI_BIG_ENDIAN;
+	}
+
+	template<typename T>
+	tri_scalar_t tri_scalar_of(){
+		static_assert(sizeof(T) == TRI_FLOAT || sizeof(T) == TRI_DOUBLE, "only float and double are stored");
+		return (sizeof(T) == TRI_FLOAT) ? TRI_FLOAT : TRI_DOUBLE;
+	}
+
+
+	class mapped_file_t{ // read-only view of the whole input: mmap when it is a regular file, otherwise read into memory (pipes)
+
+		const char* data_ = nullptr;
+		size_t size_ = 0;
+		bool mapped_ = false;
+		std::vector<char> storage_;
+
+		void reset(){
+			if(mapped_ && size_ > 0)
+				munmap(const_cast<char*>(data_), size_);
+			data_ = nullptr;
+			size_ = 0;
+			mapped_ = false;
+			storage_.clear();
+		}
+
+	public:
+		mapped_file_t(){}
+		mapped_file_t(mapped_file_t const &) = delete;
+		mapped_file_t& operator=(mapped_file_t const &) = delete;
+		~mapped_file_t(){ reset(); }
+
+		bool open(const char* path){                         // nullptr or "-" means stdin
+			reset();
+			bool from_stdin = (path == nullptr || std::strcmp(path, "-") == 0);
+			int fd = from_stdin ? 0 : ::open(path, O_RDONLY);
+			if(fd < 0)
+				return false;
+
+			struct stat st;
+			if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+				void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if(addr != MAP_FAILED){
+					madvise(addr, st.st_size, MADV_SEQUENTIAL);
+					data_ = static_cast<const char*>(addr);
+					size_ = st.st_size;
+					mapped_ = true;
+				}
+			}
+
+			if(!mapped_){
+				char chunk[1 << 16];
+				ssize_t got;
+				while((got = ::read(fd, chunk, sizeof(chunk))) > 0)
+					storage_.insert(storage_.end(), chunk, chunk + got);
+				data_ = storage_.data();
+				size_ = storage_.size();
+			}
+
+			if(!from_stdin)
+				::close(fd);
+			return true;
+		}
+
+		const char* data() const{ return data_; }
+		size_t size() const{ return size_; }
+	};
+
+
+	class tri_file_t{ // binary container laid over a mapped_file_t (does not own the memory)
+
+		tri_header_t header_;
+		const char* payload_ = nullptr;
+
+	public:
+		static bool is_binary(const char* data, size_t size){
+			return size >= sizeof(tri_magic) && std::memcmp(data, tri_magic, sizeof(tri_magic)) == 0;
+		}
+
+		static bool valid_header(tri_header_t const &header){ // magic aside
+			return header.version == tri_version && header.flags == native_tri_flags() && (header.scalar == TRI_FLOAT || header.scalar == TRI_DOUBLE);
+		}
+
+		bool open(const char* data, size_t size){            // false if the header is broken or the payload is truncated
+			payload_ = nullptr;
+			if(size < sizeof(tri_header_t) || !is_binary(data, size))
+				return false;
+			std::memcpy(&header_, data, sizeof(tri_header_t));
+			if(!valid_header(header_))
+				return false;
+			if((size - sizeof(tri_header_t)) / (9 * header_.scalar) < header_.count)
+				return false;
+			payload_ = data + sizeof(tri_header_t);
+			return true;
+		}
+
+		size_t count() const{ return header_.count; }
+		tri_scalar_t scalar() const{ return static_cast<tri_scalar_t>(header_.scalar); }
+
+		template<typename T>
+		const T* coords() const{                              // zero-copy access, nullptr if the file stores another type
+			return (payload_ != nullptr && header_.scalar == tri_scalar_of<T>()) ? reinterpret_cast<const T*>(payload_) : nullptr;
+		}
+
+		template<typename T>
+		point_t<T> vertex(size_t tri, int vert) const{        // converting access, works for both stored types
+			size_t off = tri * 9 + vert * 3;
+			if(header_.scalar == TRI_FLOAT){
+				const float* c = reinterpret_cast<const float*>(payload_) + off;
+				return point_t<T>(c[0], c[1], c[2]);
+			}
+			const double* c = reinterpret_cast<const double*>(payload_) + off;
+			return point_t<T>(c[0], c[1], c[2]);
+		}
+	};
+
+
+	template<typename T>
+	class tri_writer_t{ // writes the binary container, count is patched on close() if the stream is seekable
+
+		FILE* out_;
+		uint64_t count_ = 0;
+		std::vector<T> buf_;
+
+		void flush_buf(){
+			if(!buf_.empty())
+				std::fwrite(buf_.data(), sizeof(T), buf_.size(), out_);
+			buf_.clear();
+		}
+
+	public:
+		tri_writer_t(FILE* out, uint64_t expected_count): out_(out){
+			tri_header_t header;
+			std::memset(&header, 0, sizeof(header));
+			std::memcpy(header.magic, tri_magic, sizeof(tri_magic));
+			header.version = tri_version;
+			header.count = expected_count;
+			header.scalar = tri_scalar_of<T>();
+			header.flags = native_tri_flags();
+			std::fwrite(&header, sizeof(header), 1, out_);
+			buf_.reserve(9 * 4096);
+		}
+
+		void write(point_t<T> const &a, point_t<T> const &b, point_t<T> const &c){
+			T tri[9] = {a.x_, a.y_, a.z_, b.x_, b.y_, b.z_, c.x_, c.y_, c.z_};
+			buf_.insert(buf_.end(), tri, tri + 9);
+			count_++;
+			if(buf_.size() >= 9 * 4096)
+				flush_buf();
+		}
+
+		void write(polygon_t<T> const &tri){
+			write(tri.vertices[0], tri.vertices[1], tri.vertices[2]);
+		}
+
+		void write(const T* coords, size_t count){ // count triangles, 9 scalars each
+			flush_buf();
+			std::fwrite(coords, sizeof(T), 9 * count, out_);
+			count_ += count;
+		}
+
+		void close(){
+			flush_buf();
+			if(std::fseek(out_, offsetof(tri_header_t, count), SEEK_SET) == 0){
+				std::fwrite(&count_, sizeof(count_), 1, out_);
+				std::fseek(out_, 0, SEEK_END);
+			}
+			std::fflush(out_);
+		}
+	};
+
+
+//*********TEXT FORMAT BEGIN*************
+//
+//	  "count x y z x y z x y z ..." separated by any whitespace, as written by gen_triangles / point_t::print()
+//	  the body is split at line boundaries and the chunks are parsed with std::from_chars in parallel
+
+	inline bool is_text_space(char c){
+		return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+	}
+
+	template<typename T>
+	const char* parse_text_number(const char* p, const char* end, T &val){ // nullptr if the token at p is not a finite number
+		while(p < end && is_text_space(*p))
+			p++;
+		if(p < end && *p == '+')                                         // from_chars does not take a leading plus, iostream does
+			p++;
+		auto res = std::from_chars(p, end, val);
+		if(res.ec != std::errc() || (res.ptr < end && !is_text_space(*res.ptr)))
+			return nullptr;
+		if(!std::isfinite(val))                                          // from_chars reads "nan" and "inf", iostream does not
+			return nullptr;
+		return res.ptr;
+	}
+
+	template<typename T>
+	struct text_chunk_t{ // result of parsing one piece of the body
+		std::vector<T> values;
+		bool failed = false;                                             // stopped on a token that is not a number
+	};
+
+	template<typename T>
+	void parse_text_chunk(const char* p, const char* end, size_t max_values, text_chunk_t<T> &chunk){
+		chunk.values.reserve((end - p) / 8);
+		while(chunk.values.size() < max_values){
+			while(p < end && is_text_space(*p))
+				p++;
+			if(p == end)
+				return;
+			T val;
+			const char* next = parse_text_number(p, end, val);
+			if(next == nullptr){
+				chunk.failed = true;
+				return;
+			}
+			chunk.values.push_back(val);
+			p = next;
+		}
+	}
+
+	template<typename T>
+	bool parse_text_triangles(const char* data, size_t size, std::vector<T> &coords, unsigned threads = 0){ // false on malformed or short input
+		const char* end = data + size;
+		long long tri_n = 0;
+		while(data < end && is_text_space(*data))
+			data++;
+		auto res = std::from_chars(data, end, tri_n);
+		if(res.ec != std::errc() || tri_n < 0 || (res.ptr < end && !is_text_space(*res.ptr)))
+			return false;
+		const char* body = res.ptr;
+		if((unsigned long long)tri_n > (size_t)(end - body) / 18)                  // a separator and a digit per value at least
+			return false;
+		size_t n_values = tri_n * 9;
+
+		if(threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		size_t min_chunk = 1 << 20;
+		size_t n_chunks = std::min<size_t>(threads, (end - body) / min_chunk + 1);
+
+		std::vector<const char*> bounds{body};                          // chunk borders, moved forward to the next line start
+		for(size_t i = 1; i < n_chunks; i++){
+			const char* cut = body + (end - body) * i / n_chunks;
+			cut = std::max(cut, bounds.back());
+			while(cut < end && *cut != '\n')
+				cut++;
+			bounds.push_back(cut);
+		}
+		bounds.push_back(end);
+
+		std::vector<text_chunk_t<T>> chunks(n_chunks);
+		std::vector<std::thread> workers;
+		for(size_t i = 1; i < n_chunks; i++)
+			workers.emplace_back(parse_text_chunk<T>, bounds[i], bounds[i + 1], n_values, std::ref(chunks[i]));
+		parse_text_chunk<T>(bounds[0], bounds[1], n_values, chunks[0]);
+		for(auto &w : workers)
+			w.join();
+
+		coords.resize(n_values);
+		size_t filled = 0;
+		for(size_t i = 0; i < n_chunks && filled < n_values; i++){
+			size_t take = std::min(chunks[i].values.size(), n_values - filled);
+			std::copy(chunks[i].values.begin(), chunks[i].values.begin() + take, coords.begin() + filled);
+			filled += take;
+			if(chunks[i].failed)                                          // whatever follows the bad token does not count
+				break;
+		}
+		return filled == n_values;
+	}
+
+//*********TEXT FORMAT END***************
+
+
+	template<typename T>
+	bool load_triangles(mapped_file_t const &input, std::vector<T> &storage, const T* &coords, size_t &count){ // either format; storage stays empty when the mapping is used as is
+		storage.clear();
+		if(tri_file_t::is_binary(input.data(), input.size())){
+			tri_file_t file;
+			if(!file.open(input.data(), input.size()))
+				return false;
+			count = file.count();
+			coords = file.coords<T>();
+			if(coords == nullptr){
+				storage.resize(count * 9);
+				for(size_t i = 0; i < count; i++)
+					for(int j = 0; j < 3; j++){
+						point_t<T> pnt = file.vertex<T>(i, j);
+						storage[i * 9 + j * 3] = pnt.x_;
+						storage[i * 9 + j * 3 + 1] = pnt.y_;
+						storage[i * 9 + j * 3 + 2] = pnt.z_;
+					}
+				coords = storage.data();
+			}
+			return true;
+		}
+
+		if(!parse_text_triangles(input.data(), input.size(), storage))
+			return false;
+		count = storage.size() / 9;
+		coords = storage.data();
+		return true;
+	}
+
+
+
+	class input_reader_t{ // the input read front to back through a buffer of its own, nothing else of it kept in memory (pipes included)
+
+		int fd_ = -1;
+		bool owned_ = false;
+		bool eof_ = false;
+		std::vector<char> buf_;
+		size_t begin_ = 0;                 // unread bytes are buf_[begin_, buf_.size())
+
+		static constexpr size_t chunk_ = 1 << 20;
+
+	public:
+		input_reader_t(){}
+		input_reader_t(input_reader_t const &) = delete;
+		input_reader_t& operator=(input_reader_t const &) = delete;
+		~input_reader_t(){
+			if(owned_)
+				::close(fd_);
+		}
+
+		bool open(const char* path){                         // nullptr or "-" means stdin
+			bool from_stdin = (path == nullptr || std::strcmp(path, "-") == 0);
+			fd_ = from_stdin ? 0 : ::open(path, O_RDONLY);
+			owned_ = !from_stdin && fd_ >= 0;
+			return fd_ >= 0;
+		}
+
+		size_t fill(size_t n){ // buffers at least n unread bytes unless the input ends first, returns how many there are
+			while(size() < n && !eof_){
+				if(begin_ > 0){
+					buf_.erase(buf_.begin(), buf_.begin() + begin_);
+					begin_ = 0;
+				}
+				size_t old = buf_.size();
+				buf_.resize(old + std::max(chunk_, n - old));
+				ssize_t got = ::read(fd_, buf_.data() + old, buf_.size() - old);
+				buf_.resize(old + std::max<ssize_t>(got, 0));
+				eof_ = got <= 0;
+			}
+			return size();
+		}
+
+		const char* data() const{ return buf_.data() + begin_; }
+		size_t size() const{ return buf_.size() - begin_; }
+		void consume(size_t n){ begin_ += n; }
+
+		bool next_token(const char* &token, size_t &length){ // the next whitespace separated token, false at the end of the input
+			size_t skip = 0;
+			for(;; skip++){
+				if(skip == size() && fill(skip + 1) == skip)
+					return false;
+				if(!is_text_space(data()[skip]))
+					break;
+			}
+			consume(skip);
+			for(length = 1;; length++){
+				if(length == size() && fill(length + 1) == length)
+					break;
+				if(is_text_space(data()[length]))
+					break;
+			}
+			token = data();
+			consume(length);
+			return true;
+		}
+	};
+
+	template<typename T, typename Fn>
+	bool for_each_input_triangle(input_reader_t &input, Fn &&fn){ // fn(index, coords) for every triangle in order without keeping them all, false on malformed input
+		T coords[9];
+		if(input.fill(sizeof(tri_header_t)) >= sizeof(tri_magic) && tri_file_t::is_binary(input.data(), input.size())){
+			tri_header_t header;
+			if(input.size() < sizeof(header))
+				return false;
+			std::memcpy(&header, input.data(), sizeof(header));
+			input.consume(sizeof(header));
+			if(!tri_file_t::valid_header(header))
+				return false;
+			size_t tri_size = 9 * header.scalar;
+			for(size_t i = 0; i < header.count; i++){
+				if(input.fill(tri_size) < tri_size)
+					return false;
+				for(int k = 0; k < 9; k++)
+					if(header.scalar == TRI_FLOAT){
+						float v;
+						std::memcpy(&v, input.data() + k * sizeof(v), sizeof(v));
+						coords[k] = v;
+					}
+					else{
+						double v;
+						std::memcpy(&v, input.data() + k * sizeof(v), sizeof(v));
+						coords[k] = v;
+					}
+				input.consume(tri_size);
+				fn(i, (const T*)coords);
+			}
+			return true;
+		}
+
+		const char* token;                             // text is parsed sequentially, number by number
+		size_t length;
+		long long tri_n = 0;
+		if(!input.next_token(token, length))
+			return false;
+		auto res = std::from_chars(token, token + length, tri_n);
+		if(res.ec != std::errc() || tri_n < 0 || res.ptr != token + length)
+			return false;
+		for(long long i = 0; i < tri_n; i++){
+			for(int k = 0; k < 9; k++)
+				if(!input.next_token(token, length) || parse_text_number(token, token + length, coords[k]) == nullptr)
+					return false;
+			fn((size_t)i, (const T*)coords);
+		}
+		return true;
+	}
+
+/*
+	              TRIANGLE STREAM
+	  the triangles of either format in consecutive blocks of any size, in input order, handed out while the rest of the input
+	  is still being read: the text body is cut at line boundaries into pieces that background threads parse
+	  ahead of the reader (a couple of pieces per thread, so memory stays bounded), binary blocks are converted
+	  on demand; pieces are glued back in order, so the blocks are the same as parse_text_triangles() would give
+	  a malformed or short text only shows when the stream gets there: next() returns false and good() tells why
+
+*/
+
+template<typename T>
+	class triangle_stream_t{
+
+		size_t count_ = 0;                  // triangles announced by the header
+		size_t next_ = 0;                   // first triangle of the next block
+		bool good_ = true;
+		bool binary_ = false;
+		tri_file_t file_;
+
+		std::vector<const char*> bounds_;   // text pieces [bounds_[c], bounds_[c + 1])
+		std::vector<text_chunk_t<T>> pieces_;
+		std::vector<char> parsed_;
+		size_t claimed_ = 0;                // pieces taken by the parsers
+		size_t taken_ = 0;                  // pieces taken by next()
+		size_t ahead_ = 2;                  // parsed pieces waiting for next(), at most
+		bool stop_ = false;                 // parsed_, claimed_, taken_ and stop_ go under mutex_
+		bool truncated_ = false;            // a piece stopped on a bad token, nothing after it counts
+		std::mutex mutex_;
+		std::condition_variable changed_;
+		std::vector<std::thread> parsers_;
+
+		std::vector<T> carry_;              // parsed values not handed out yet, from carry_pos_ on
+		size_t carry_pos_ = 0;
+
+		size_t piece_count() const{ return bounds_.empty() ? 0 : bounds_.size() - 1; }
+
+		void parse_pieces(){
+			std::unique_lock<std::mutex> lock{mutex_};
+			for(;;){
+				changed_.wait(lock, [this]{ return stop_ || claimed_ == piece_count() || claimed_ < taken_ + ahead_; });
+				if(stop_ || claimed_ == piece_count())
+					return;
+				size_t c = claimed_++;
+				lock.unlock();
+				parse_text_chunk<T>(bounds_[c], bounds_[c + 1], 9 * count_, pieces_[c]);
+				lock.lock();
+				parsed_[c] = 1;
+				changed_.notify_all();
+			}
+		}
+
+		bool take_piece(){ // appends the next piece to the carry, false if there is none
+			if(truncated_ || taken_ == piece_count())
+				return false;
+			text_chunk_t<T> piece;
+			{
+				std::unique_lock<std::mutex> lock{mutex_};
+				changed_.wait(lock, [this]{ return parsed_[taken_] != 0; });
+				piece = std::move(pieces_[taken_++]);
+			}
+			changed_.notify_all();
+			if(carry_pos_ > carry_.size() / 2){
+				carry_.erase(carry_.begin(), carry_.begin() + carry_pos_);
+				carry_pos_ = 0;
+			}
+			carry_.insert(carry_.end(), piece.values.begin(), piece.values.end());
+			truncated_ = piece.failed;
+			return true;
+		}
+
+	public:
+
+		triangle_stream_t(mapped_file_t const &input, unsigned threads = 0){ // threads 0 - as many as the hardware has
+			const char* data = input.data();
+			size_t size = input.size();
+			if(tri_file_t::is_binary(data, size)){
+				binary_ = true;
+				good_ = file_.open(data, size);
+				count_ = good_ ? file_.count() : 0;
+				return;
+			}
+
+			const char* end = data + size;
+			long long tri_n = 0;
+			while(data < end && is_text_space(*data))
+				data++;
+			auto res = std::from_chars(data, end, tri_n);
+			if(res.ec != std::errc() || tri_n < 0 || (res.ptr < end && !is_text_space(*res.ptr))){
+				good_ = false;
+				return;
+			}
+			count_ = tri_n;
+
+			const char* body = res.ptr;
+			size_t piece_bytes = std::max<size_t>(1 << 20, (end - body) / 64);
+			bounds_.push_back(body);
+			while(bounds_.back() < end){
+				const char* cut = std::min<const char*>(end, bounds_.back() + piece_bytes);
+				while(cut < end && *cut != '\n')
+					cut++;
+				bounds_.push_back(cut);
+			}
+			pieces_.resize(piece_count());
+			parsed_.resize(piece_count());
+
+			if(threads == 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+			threads = std::min<size_t>(threads, std::max<size_t>(piece_count(), 1));
+			ahead_ = 2 * threads;
+			for(unsigned t = 0; t < threads; t++)
+				parsers_.emplace_back(&triangle_stream_t::parse_pieces, this);
+		}
+
+		~triangle_stream_t(){
+			{
+				std::lock_guard<std::mutex> lock{mutex_};
+				stop_ = true;
+			}
+			changed_.notify_all();
+			for(auto &parser : parsers_)
+				parser.join();
+		}
+
+		triangle_stream_t(triangle_stream_t const &) = delete;
+		triangle_stream_t &operator=(triangle_stream_t const &) = delete;
+
+		size_t count() const{ return count_; }
+		size_t position() const{ return next_; }      // id of the first triangle of the next block
+		bool good() const{ return good_; }              // false if the input turned out malformed or short
+
+		bool next(std::vector<T> &coords, size_t block){ // the next block of up to block triangles, 9 values each, false at the end or on bad input
+			coords.clear();
+			if(!good_ || next_ == count_ || block == 0)
+				return false;
+			size_t n = std::min(block, count_ - next_);
+
+			if(binary_){
+				coords.resize(9 * n);
+				for(size_t i = 0; i < n; i++)
+					for(int j = 0; j < 3; j++){
+						point_t<T> pnt = file_.vertex<T>(next_ + i, j);
+						coords[i * 9 + j * 3] = pnt.x_;
+						coords[i * 9 + j * 3 + 1] = pnt.y_;
+						coords[i * 9 + j * 3 + 2] = pnt.z_;
+					}
+				next_ += n;
+				return true;
+			}
+
+			while(carry_.size() - carry_pos_ < 9 * n)
+				if(!take_piece()){
+					good_ = false;
+					return false;
+				}
+			coords.assign(carry_.begin() + carry_pos_, carry_.begin() + carry_pos_ + 9 * n);
+			carry_pos_ += 9 * n;
+			next_ += n;
+			return true;
+		}
+	};
+
+//*********OUTPUT BEGIN******************
+//
+//	  results leave through big fwrite()s: every thread fills its own out_buffer_t and hands it over to the shared
+//	  out_file_t when it is full, so nothing is flushed per line and memory does not grow with the number of results
+//	  text is one id or one "i j" pair per line, binary is uint32 ids in the byte order of the machine (two per pair)
+//	  buffers of different threads reach the file in any order
+//	  after start_writer() a background thread does the fwrite()s and a full buffer is only queued (a few at most),
+//	  so the searching threads don't wait for a slow disk or pipe
+
+	enum out_format_t {OUT_TEXT, OUT_BINARY};
+
+	class out_file_t{
+
+		FILE* out_ = stdout;
+		bool owned_ = false;
+		out_format_t format_;
+		std::mutex mutex_;
+
+		std::thread writer_;
+		std::deque<std::vector<char>> queue_;
+		std::condition_variable queued_, drained_;
+		bool stopping_ = false;
+		static const size_t max_queued_ = 8;
+
+		void write_queued(){ // the writer thread
+			std::unique_lock<std::mutex> lock{mutex_};
+			for(;;){
+				queued_.wait(lock, [this]{ return stopping_ || !queue_.empty(); });
+				if(queue_.empty())
+					return;
+				std::vector<char> block = std::move(queue_.front());
+				queue_.pop_front();
+				drained_.notify_all();
+				lock.unlock();
+				std::fwrite(block.data(), 1, block.size(), out_);
+				lock.lock();
+			}
+		}
+
+		void stop_writer(){ // writes out what is queued
+			if(!writer_.joinable())
+				return;
+			{
+				std::lock_guard<std::mutex> lock{mutex_};
+				stopping_ = true;
+			}
+			queued_.notify_one();
+			writer_.join();
+			stopping_ = false;
+		}
+
+	public:
+		out_file_t(out_format_t format = OUT_TEXT): format_(format){
+
+		}
+
+		out_file_t(out_file_t const &) = delete;
+		out_file_t &operator=(out_file_t const &) = delete;
+
+		~out_file_t(){
+			close();
+		}
+
+		bool open(const char* path){ // nullptr or "-" - stdout
+			close();
+			if(path == nullptr || std::strcmp(path, "-") == 0){
+				out_ = stdout;
+				return true;
+			}
+			out_ = std::fopen(path, (format_ == OUT_BINARY) ? "wb" : "w");
+			owned_ = (out_ != nullptr);
+			return owned_;
+		}
+
+		bool open_fd(int fd){ // an open descriptor (a pipe), closed by close()
+			close();
+			out_ = fdopen(fd, (format_ == OUT_BINARY) ? "wb" : "w");
+			owned_ = (out_ != nullptr);
+			if(!owned_)
+				out_ = stdout;
+			return owned_;
+		}
+
+		void close(){
+			stop_writer();
+			if(owned_)
+				std::fclose(out_);
+			else if(out_ != nullptr)
+				std::fflush(out_);
+			out_ = stdout;
+			owned_ = false;
+		}
+
+		out_format_t format() const{ return format_; }
+
+		void start_writer(){ // until close()
+			if(!writer_.joinable())
+				writer_ = std::thread(&out_file_t::write_queued, this);
+		}
+
+		void write(std::vector<char> &&block){ // taken over only when queued for the writer thread
+			std::unique_lock<std::mutex> lock{mutex_};
+			if(!writer_.joinable()){
+				std::fwrite(block.data(), 1, block.size(), out_);
+				return;
+			}
+			drained_.wait(lock, [this]{ return queue_.size() < max_queued_; });
+			queue_.push_back(std::move(block));
+			queued_.notify_one();
+		}
+
+		void write(const char* data, size_t size){
+			if(writer_.joinable())
+				write(std::vector<char>(data, data + size));
+			else{
+				std::lock_guard<std::mutex> lock{mutex_};
+				std::fwrite(data, 1, size, out_);
+			}
+		}
+	};
+
+
+	class out_buffer_t{
+
+		out_file_t &file_;
+		std::vector<char> buf_;
+
+		static const size_t capacity_ = 1 << 20;
+
+		void make_room(size_t bytes){ // for a whole record, so a record never spans two writes
+			if(buf_.size() + bytes > capacity_)
+				flush();
+		}
+
+		void put_text(uint32_t val, char end){ // at most 11 bytes, 16 of room needed
+			size_t pos = buf_.size();
+			buf_.resize(pos + 16);
+			char* last = std::to_chars(buf_.data() + pos, buf_.data() + pos + 15, val).ptr;
+			*last++ = end;
+			buf_.resize(last - buf_.data());
+		}
+
+		void put_binary(uint32_t val){
+			const char* bytes = reinterpret_cast<const char*>(&val);
+			buf_.insert(buf_.end(), bytes, bytes + sizeof(val));
+		}
+
+	public:
+		out_buffer_t(out_file_t &file): file_(file){
+			buf_.reserve(capacity_);
+		}
+
+		out_buffer_t(out_buffer_t const &) = delete;
+		out_buffer_t &operator=(out_buffer_t const &) = delete;
+
+		~out_buffer_t(){
+			flush();
+		}
+
+		void put(uint32_t id){
+			if(file_.format() == OUT_BINARY){
+				make_room(sizeof(id));
+				put_binary(id);
+			}
+			else{
+				make_room(16);
+				put_text(id, '\n');
+			}
+		}
+
+		void put_pair(uint32_t i, uint32_t j){
+			if(file_.format() == OUT_BINARY){
+				make_room(2 * sizeof(i));
+				put_binary(i);
+				put_binary(j);
+			}
+			else{
+				make_room(32);
+				put_text(i, ' ');
+				put_text(j, '\n');
+			}
+		}
+
+		void flush(){
+			if(!buf_.empty())
+				file_.write(std::move(buf_));
+			buf_.clear();
+			buf_.reserve(capacity_);
+		}
+	};
+
+//*********OUTPUT END********************
+
+};
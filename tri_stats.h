@@ -0,0 +1,171 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <utility>
+#ifdef TRI_STATS
+#include <chrono>
+#include <memory>
+#include <mutex>
+#endif
+
+namespace lingeo3D{
+
+/*
+	              INSTRUMENTATION
+	  hot path counters and phase timings of a run, written as json by write_stats()
+	  everything here is compiled out unless TRI_STATS is defined (make all FLAGS="-O2 -DTRI_STATS"):
+	  without it stat_add() and stat_phase_t are empty inline code and tri_stats_enabled is false
+	  counters are kept per thread (no shared cache lines in the search) and summed when the stats are written,
+	  so they must only be read once the searching threads are done; phases are timed on the main thread
+
+*/
+
+	enum stat_t {
+		STAT_X_CANDIDATES,       // boxes in the x range of a triangle (sorted cubes), open at its start (sweep and prune) or in its window cells (out-of-core sweep)
+		STAT_Z_REJECTS,          // x candidates dropped by z_interfere
+		STAT_Y_REJECTS,          // x candidates dropped by y_interfere
+		STAT_BROAD_PAIRS,        // pairs handed to the narrowphase
+		STAT_FLAGGED_SKIPS,      // pairs not checked since both triangles are marked already
+		STAT_INTERSECT_CALLS,    // triangle pairs checked by the narrowphase (batch lanes included)
+		STAT_INTERSECT_HITS,
+		STAT_DEGENERATE,         // input triangles with NaN coordinates or without area (triangle_t::degenerate)
+		STAT_KINDS
+	};
+
+	const char* const stat_names[STAT_KINDS] = {"x_candidates", "z_rejects", "y_rejects", "broad_pairs", "flagged_skips", "intersect_calls", "intersect_hits", "degenerate"};
+
+	struct stats_info_t{ // what the run was, key and value rendered as json
+		std::vector<std::pair<std::string, std::string>> fields;
+	};
+
+	inline stats_info_t &stats_info(){
+		static stats_info_t info;
+		return info;
+	}
+
+	inline void stat_info(const char* key, const char* value){
+		stats_info().fields.push_back({key, std::string("\"") + value + "\""});
+	}
+
+	inline void stat_info(const char* key, uint64_t value){
+		stats_info().fields.push_back({key, std::to_string(value)});
+	}
+
+#ifdef TRI_STATS
+
+	const bool tri_stats_enabled = true;
+
+	struct alignas(64) stat_block_t{
+		uint64_t count[STAT_KINDS] = {};
+	};
+
+	struct stats_registry_t{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<stat_block_t>> blocks;            // one per thread that counted anything, never freed
+		std::vector<std::pair<std::string, double>> phases;           // name, seconds
+	};
+
+	inline stats_registry_t &stats_registry(){
+		static stats_registry_t registry;
+		return registry;
+	}
+
+	inline stat_block_t &stat_local(){
+		thread_local stat_block_t* block = []{
+			stats_registry_t &registry = stats_registry();
+			std::lock_guard<std::mutex> lock{registry.mutex};
+			registry.blocks.emplace_back(new stat_block_t);
+			return registry.blocks.back().get();
+		}();
+		return *block;
+	}
+
+	inline void stat_add(stat_t stat, uint64_t n = 1){
+		stat_local().count[stat] += n;
+	}
+
+	class stat_phase_t{ // adds the time from construction to stop() (or destruction) to phase "name"
+
+		const char* name_;
+		std::chrono::steady_clock::time_point start_;
+		bool running_ = true;
+
+	public:
+		explicit stat_phase_t(const char* name): name_(name), start_(std::chrono::steady_clock::now()){
+
+		}
+
+		~stat_phase_t(){
+			stop();
+		}
+
+		void stop(){
+			if(!running_)
+				return;
+			running_ = false;
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+			stats_registry_t &registry = stats_registry();
+			std::lock_guard<std::mutex> lock{registry.mutex};
+			for(auto &phase : registry.phases)
+				if(phase.first == name_){
+					phase.second += seconds;
+					return;
+				}
+			registry.phases.push_back({name_, seconds});
+		}
+	};
+
+#else
+
+	const bool tri_stats_enabled = false;
+
+	inline void stat_add(stat_t, uint64_t = 1){
+
+	}
+
+	class stat_phase_t{
+
+	public:
+		explicit stat_phase_t(const char*){
+
+		}
+
+		void stop(){
+
+		}
+	};
+
+#endif
+
+	inline bool write_stats(const char* path){ // json with the run info, phases in milliseconds and counter totals
+		FILE* out = std::fopen(path, "w");
+		if(out == nullptr)
+			return false;
+		std::fprintf(out, "{\n  \"enabled\": %s,\n  \"run\": {", tri_stats_enabled ? "true" : "false");
+		for(size_t k = 0; k < stats_info().fields.size(); k++)
+			std::fprintf(out, "%s\"%s\": %s", (k == 0) ? "" : ", ", stats_info().fields[k].first.c_str(), stats_info().fields[k].second.c_str());
+		std::fprintf(out, "}");
+
+#ifdef TRI_STATS
+		stats_registry_t &registry = stats_registry();
+		std::lock_guard<std::mutex> lock{registry.mutex};
+		std::fprintf(out, ",\n  \"phases_ms\": {");
+		for(size_t k = 0; k < registry.phases.size(); k++)
+			std::fprintf(out, "%s\"%s\": %.3f", (k == 0) ? "" : ", ", registry.phases[k].first.c_str(), registry.phases[k].second * 1e3);
+		std::fprintf(out, "},\n  \"counters\": {");
+		for(int s = 0; s < STAT_KINDS; s++){
+			uint64_t total = 0;
+			for(auto const &block : registry.blocks)
+				total += block->count[s];
+			std::fprintf(out, "%s\"%s\": %llu", (s == 0) ? "" : ", ", stat_names[s], (unsigned long long)total);
+		}
+		std::fprintf(out, "}");
+#endif
+
+		std::fprintf(out, "\n}\n");
+		return std::fclose(out) == 0;
+	}
+
+};
@@ -1,201 +1,407 @@
 #include "lingeo3D.h"
+#include "tri_io.h"
+#include "triangle_soup.h"
+#include "sorted_cubes.h"
+#include "sweep_prune.h"
+#include "uniform_grid.h"
+#include "bvh.h"
+#include "size_buckets.h"
+#include "narrowphase.h"
+#include "tri_batch.h"
+#include "thread_pool.h"
+#include "tri_stats.h"
+#include "stream_sweep.h"
+#include "spatial_order.h"
+#include "pipelined_search.h"
+#include "sharded_search.h"
 #include <iostream>
 #include <vector>
-#include <unordered_map>
+#include <deque>
 #include <algorithm>
-#include <ctime>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
 
 using namespace lingeo3D;
 
 #define WITH_SORTED
-//#define TRI_LOGGING
-
-template<typename T>
-class sorted_cubes;
-
-template<typename T>
-class cube_t{ //3d cube
-
-	T x1, y1, z1, x2, y2, z2;
-
-public:
-	cube_t(polygon_t<T> polygon = polygon_t<T>{}, T cube_size = 0.0){
-		T min_x = -1.0, min_y = -1.0, min_z = -1.0, max_x = 0.0, max_y = 0.0, max_z = 0.0;
-		for(int i = 0; i < polygon.vertices.size(); i++){
-			point_t<T> pnt = polygon.vertices[i];
-			if(min_x < 0.0 || min_x > pnt.x_) min_x = pnt.x_;
-			if(min_y < 0.0 || min_y > pnt.y_) min_y = pnt.y_;
-			if(min_z < 0.0 || min_z > pnt.z_) min_z = pnt.z_;
+//#define TRI_STATS                   // counters and phase timings for --stats (tri_stats.h), usually passed in FLAGS
+
+enum broad_t {BROAD_SORTED, BROAD_SAP, BROAD_GRID, BROAD_BVH, BROAD_BUCKETS};
+
+template<typename Broad, typename... Args>
+void search_pairs(thread_pool_t &pool, std::vector<pair_checker_t> &checkers, Args&&... args){ // builds the broadphase from args, for broadphases that hand out every candidate pair once
+	stat_phase_t build{"build"};
+	Broad broad{std::forward<Args>(args)...};
+	build.stop();
+
+	stat_phase_t search{"search"};
+	pool.run(broad.work_size(), [&](unsigned worker, size_t unit){
+		broad.for_each_pair(unit, unit + 1, checkers[worker]);
+		checkers[worker].flush();
+	});
+}
+
+void search_sorted_cubes(triangle_soup<float> const &triangles, intersect_flags_t const &intersected, thread_pool_t &pool, std::vector<pair_checker_t> &checkers){ // x range of every triangle, stops at its first hit
+	const int unit_size = 256;
+	int tri_n = triangles.size();
+	stat_phase_t build{"build"};
+	sorted_cubes<float> s_cubes{triangles};
+	build.stop();
 
-			if(max_x < pnt.x_) max_x = pnt.x_;
-			if(max_y < pnt.y_) max_y = pnt.y_;
-			if(max_z < pnt.z_) max_z = pnt.z_;
+	stat_phase_t search{"search"};
+	pool.run((tri_n + unit_size - 1) / unit_size, [&](unsigned worker, size_t unit){
+		pair_checker_t &checker = checkers[worker];
+		bool all = checker.all_pairs();      // every pair once (from its smaller index), no early exits
+		int last = std::min<int>(tri_n, (unit + 1) * unit_size);
+		for(int i = unit * unit_size; i < last; i++){ // N
 
+			if(!all && intersected[i])
+				continue;
+			s_cubes.for_each_candidate(i, [&](int j){ // logN + M
+				checker(i, j);
+				return all || !intersected[i];
+			}, all);
+			checker.flush();
+		}
+	});
+}
+
+void search_broad(broad_t broad, float cell_size, triangle_soup<float> const &triangles, intersect_flags_t const &intersected, thread_pool_t &pool, std::vector<pair_checker_t> &checkers){ // the chosen broadphase, the sharded search runs it in every shard
+	if(broad == BROAD_SAP) // TIME COMPLEXITY: O(N * logN + K) ; K - number of pairs overlapping by x, every pair is visited once
+		search_pairs<sweep_prune<float>>(pool, checkers, triangles);
+	else if(broad == BROAD_GRID) // TIME COMPLEXITY: O(N + C) ; C - number of pairs sharing a cell, does not depend on the x slab density
+		search_pairs<uniform_grid<float>>(pool, checkers, triangles, cell_size);
+	else if(broad == BROAD_BVH) // TIME COMPLEXITY: O(N * logN + K) ; K - number of pairs with overlapping node boxes, for any spread of sizes and positions
+		search_pairs<bvh_tree<float>>(pool, checkers, triangles, pool.size());
+	else if(broad == BROAD_BUCKETS) // TIME COMPLEXITY: O(N * (B * logN + M)) ; B - number of size classes, M - x overlaps of tight boxes within a class padding
+		search_pairs<size_buckets<float>>(pool, checkers, triangles);
+	else
+		search_sorted_cubes(triangles, intersected, pool, checkers);
+}
+
+bool parse_size(const char* str, size_t &bytes){ // 512M, 2G, 100000K or plain bytes
+	char* end = nullptr;
+	double value = std::strtod(str, &end);
+	double unit = 1.0;
+	if(*end == 'K' || *end == 'k')
+		unit = 1024.0;
+	else if(*end == 'M' || *end == 'm')
+		unit = 1024.0 * 1024.0;
+	else if(*end == 'G' || *end == 'g')
+		unit = 1024.0 * 1024.0 * 1024.0;
+	if(unit != 1.0)
+		end++;
+	if(end == str || *end != '\0' || !(value > 0.0))
+		return false;
+	bytes = value * unit;
+	return true;
+}
+
+void usage(){
+	std::cout << "Usage: inter_sorted [--broad sorted|sap|grid|bvh|buckets] [--cell size] [--narrow angle|planes|batch|exact] [--simd scalar|sse|avx2|avx512] [--threads N] [--pairs txt|bin] [--output path] [--stats path] [--reorder none|morton|hilbert] [--mem-limit size] [--pipeline] [--shards N] [input]\n";
+	std::cout << "       --mem-limit has a sweep of its own and takes no --broad, --cell, --reorder, --pipeline or --shards\n";
+}
+
+int main(int argc, char** argv){
+	const char* input_path = nullptr;
+	narrow_t narrow = NARROW_ANGLE;
+	broad_t broad = BROAD_SORTED;
+	float cell_size = 0.0;               // uniform_grid cell, 0 - picked from the triangle sizes
+	const char* simd = nullptr;          // widest supported batch kernel by default
+	unsigned threads = 0;                // 0 - as many as the hardware has
+	bool all_pairs = false;              // every intersecting pair instead of the intersecting triangles
+	out_format_t format = OUT_TEXT;
+	reorder_t reorder = REORDER_NONE;    // search the soup in this space filling curve order (spatial_order.h)
+	const char* output_path = nullptr;   // stdout by default
+	const char* stats_path = nullptr;    // json with counters and timings, filled in when built with TRI_STATS
+	bool pipeline = false;               // search regions of the input while the rest is parsed (pipelined_search.h)
+	size_t mem_limit = 0;                // out-of-core sweep (stream_sweep.h) in about this much memory, 0 - everything in memory
+	int shards = 1;                      // processes to split the search between (sharded_search.h), --threads is per shard then
+
+	for(int i = 1; i < argc; i++){
+		if(std::strcmp(argv[i], "--narrow") == 0 && i + 1 < argc){
+			i++;
+			if(std::strcmp(argv[i], "angle") == 0)
+				narrow = NARROW_ANGLE;
+			else if(std::strcmp(argv[i], "planes") == 0)
+				narrow = NARROW_PLANES;
+			else if(std::strcmp(argv[i], "batch") == 0)
+				narrow = NARROW_BATCH;
+			else if(std::strcmp(argv[i], "exact") == 0)
+				narrow = NARROW_EXACT;
+			else{
+				usage();
+				return 0;
+			}
+		}
+		else if(std::strcmp(argv[i], "--broad") == 0 && i + 1 < argc){
+			i++;
+			if(std::strcmp(argv[i], "sorted") == 0)
+				broad = BROAD_SORTED;
+			else if(std::strcmp(argv[i], "sap") == 0)
+				broad = BROAD_SAP;
+			else if(std::strcmp(argv[i], "grid") == 0)
+				broad = BROAD_GRID;
+			else if(std::strcmp(argv[i], "bvh") == 0)
+				broad = BROAD_BVH;
+			else if(std::strcmp(argv[i], "buckets") == 0)
+				broad = BROAD_BUCKETS;
+			else{
+				usage();
+				return 0;
+			}
+		}
+		else if(std::strcmp(argv[i], "--cell") == 0 && i + 1 < argc)
+			cell_size = std::atof(argv[++i]);
+		else if(std::strcmp(argv[i], "--simd") == 0 && i + 1 < argc)
+			simd = argv[++i];
+		else if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = std::atoi(argv[++i]);
+		else if(std::strcmp(argv[i], "--pairs") == 0 && i + 1 < argc){
+			i++;
+			all_pairs = true;
+			if(std::strcmp(argv[i], "txt") == 0)
+				format = OUT_TEXT;
+			else if(std::strcmp(argv[i], "bin") == 0)
+				format = OUT_BINARY;
+			else{
+				usage();
+				return 0;
+			}
+		}
+		else if(std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			output_path = argv[++i];
+		else if(std::strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+			stats_path = argv[++i];
+		else if(std::strcmp(argv[i], "--reorder") == 0 && i + 1 < argc){
+			i++;
+			if(std::strcmp(argv[i], "none") == 0)
+				reorder = REORDER_NONE;
+			else if(std::strcmp(argv[i], "morton") == 0)
+				reorder = REORDER_MORTON;
+			else if(std::strcmp(argv[i], "hilbert") == 0)
+				reorder = REORDER_HILBERT;
+			else{
+				usage();
+				return 0;
+			}
+		}
+		else if(std::strcmp(argv[i], "--pipeline") == 0)
+			pipeline = true;
+		else if(std::strcmp(argv[i], "--shards") == 0 && i + 1 < argc){
+			shards = std::atoi(argv[++i]);
+			if(shards < 1){
+				usage();
+				return 0;
+			}
+		}
+		else if(std::strcmp(argv[i], "--mem-limit") == 0 && i + 1 < argc){
+			if(!parse_size(argv[++i], mem_limit)){
+				usage();
+				return 0;
+			}
+		}
+		else if(input_path == nullptr && (argv[i][0] != '-' || argv[i][1] == '\0'))
+			input_path = argv[i];
+		else{
+			usage();
+			return 0;
 		}
-		x1 = min_x;
-		y1 = min_y;
-		z1 = min_z;
-
-		x2 = (max_x - min_x < cube_size) ? min_x + cube_size : max_x;
-		y2 = (max_y - min_y < cube_size) ? min_y + cube_size : max_y;
-		z2 = (max_z - min_z < cube_size) ? min_z + cube_size : max_z;
-	}
-
-	bool x_interfere(cube_t<T> const &cube) const{
-		return !(cube.x1 > x2 + flt_tolerance || cube.x2 < x1 - flt_tolerance);
 	}
 
-	bool y_interfere(cube_t<T> const &cube) const{
-		return !(cube.y1 > y2 + flt_tolerance || cube.y2 < y1 - flt_tolerance);
+	if(mem_limit != 0 && (broad != BROAD_SORTED || cell_size != 0.0 || reorder != REORDER_NONE || pipeline || shards > 1)){ // none of them would be used
+		usage();
+		return 0;
 	}
 
-	bool z_interfere(cube_t<T> const &cube) const{
-		return !(cube.z1 > z2 + flt_tolerance || cube.z2 < z1 - flt_tolerance);
-	}
+	if(mem_limit != 0){ // out-of-core: the triangles go through an external sort and a sweep, never all in memory at once
+		stat_phase_t load{"load"};
+		input_reader_t input;                // read through a buffer, a pipe isn't gathered in memory either
+		if(!input.open(input_path)){
+			std::cout << "Invalid input!\n";
+			return 0;
+		}
+		stream_sweep sweep{mem_limit, narrow, tri_batch_kernel(simd)};
+		bool spilled = true, too_many = false;
+		bool parsed = for_each_input_triangle<float>(input, [&](size_t i, const float* tri){
+			if(i >= (size_t)INT_MAX){        // ids are int
+				too_many = true;
+				return;
+			}
+			if(tri_stats_enabled && triangle_t<float>{{tri[0], tri[1], tri[2]}, {tri[3], tri[4], tri[5]}, {tri[6], tri[7], tri[8]}}.degenerate())
+				stat_add(STAT_DEGENERATE);
+			spilled = sweep.add(i, tri) && spilled;
+		});
+		if(!parsed || too_many){
+			std::cout << "Invalid input!\n";
+			return 0;
+		}
+		load.stop();
 
-	bool interfare(cube_t<T> const &cube) const{
-		return x_interfere(cube) && y_interfere(cube) && z_interfere(cube);
+		out_file_t output{format};
+		if(!output.open(output_path)){
+			std::cout << "Can't open " << output_path << "\n";
+			return 0;
+		}
+		thread_pool_t pool{threads};
+		stat_phase_t build{"build"};
+		bool sorted = spilled && sweep.sort();
+		build.stop();
+		if(!sorted || !sweep.run(pool, output, all_pairs)){
+			std::cerr << "Can't write temporary files, see TMPDIR\n";
+			return 0;
+		}
+		output.close();
+		if(sweep.window_bytes() > sweep.window_budget())
+			std::cerr << "The sweep window took " << (sweep.window_bytes() >> 10) << " KB, more than --mem-limit leaves for it\n";
+
+		if(stats_path != nullptr){
+			const char* narrow_names[] = {"angle", "planes", "batch", "exact"};
+			stat_info("broad", "stream");
+			stat_info("narrow", narrow_names[narrow]);
+			stat_info("simd", tri_batch_kernel_name(tri_batch_kernel(simd)));
+			stat_info("threads", pool.size());
+			stat_info("triangles", sweep.size() + sweep.skipped());
+			stat_info("intersected", sweep.intersected());
+			stat_info("runs", sweep.runs());
+			stat_info("window", sweep.window_peak());
+			if(!write_stats(stats_path))
+				std::cerr << "Can't write " << stats_path << "\n";
+		}
+		return 0;
 	}
 
-	friend class sorted_cubes<T>;
-};
-
-template<typename T>
-class sorted_cubes{
-	std::vector<cube_t<T>> cubes_; //holds cubes of the same size that holding their triangles inside
-
-	std::vector<int> x_sorted_cubes; //holds indexes of cubes_ sorted by x coordinate
-
-public:
-	sorted_cubes(std::vector<polygon_t<T>> const &polys){
-
-		T x_size_max = 0.0, y_size_max = 0.0, z_size_max = 0.0;
-		for(int i = 0; i < polys.size(); i++){
-			for(int j = 0; j < polys[i].vertices.size(); j++){
-				for(int k = 0; k < polys[i].vertices.size(); k++){
-					point_t<T> pnt1 = polys[i].vertices[j];
-					point_t<T> pnt2 = polys[i].vertices[k];
-					T x_size = std::abs(pnt1.x_ - pnt2.x_);
-					T y_size = std::abs(pnt1.y_ - pnt2.y_);
-					T z_size = std::abs(pnt1.z_ - pnt2.z_);
-
-					if(x_size > x_size_max) x_size_max = x_size;
-					if(y_size > y_size_max) y_size_max = y_size;
-					if(z_size > z_size_max) z_size_max = z_size;
-				}			
-
-			}			
+	if(pipeline){ // parsing, indexing, searching and writing overlap, the regions are indexed with a bvh whatever --broad says
+		const size_t regions = 8;            // the input in about this many parts, each one searched against the earlier ones
+		mapped_file_t input;
+		if(!input.open(input_path)){
+			std::cout << "Invalid input!\n";
+			return 0;
 		}
+		thread_pool_t pool{threads};
+		triangle_stream_t<float> stream{input, pool.size()};
+		if(!stream.good() || stream.count() > (size_t)INT_MAX){   // ids are int
 
-		T cube_size = 0.0;                   // cube size must be not less than maximum linear size of triangle appeared in polys to fit all of them
-		
-		if(x_size_max >= y_size_max && x_size_max >= z_size_max)
-			cube_size = x_size_max;
-		else
-			if(y_size_max >= z_size_max && y_size_max >= x_size_max)
-				cube_size = y_size_max;
-			else
-				cube_size = z_size_max;
-
-
-		for(int i = 0; i < polys.size(); i++){
-			cubes_.insert(cubes_.end(), {polys[i], cube_size});
-			x_sorted_cubes.insert(x_sorted_cubes.end(), i);
+			std::cout << "Invalid input!\n";
+			return 0;
 		}
 
-		//sorting by x coordinate
-		std::sort(x_sorted_cubes.begin(), x_sorted_cubes.end(), [this](int a1, int a2) -> bool {return cubes_[a1].x1 < cubes_[a2].x1;});
-
+		out_file_t output{format};
+		if(!output.open(output_path)){
+			std::cout << "Can't open " << output_path << "\n";
+			return 0;
+		}
+		output.start_writer();
+		pipelined_search search{narrow, tri_batch_kernel(simd)};
+		if(!search.run(stream, std::max<size_t>(1 << 16, (stream.count() + regions - 1) / regions), pool, output, all_pairs)){
+			output.close();
+			std::cout << "Invalid input!\n";
+			return 0;
+		}
+		stat_phase_t write{"output"};
+		size_t hits = all_pairs ? search.intersected() : search.write_ids(output);
+		output.close();
+		write.stop();
+
+		if(stats_path != nullptr){
+			const char* narrow_names[] = {"angle", "planes", "batch", "exact"};
+			stat_info("broad", "pipeline");
+			stat_info("narrow", narrow_names[narrow]);
+			stat_info("simd", tri_batch_kernel_name(tri_batch_kernel(simd)));
+			stat_info("threads", pool.size());
+			stat_info("triangles", search.size());
+			stat_info("intersected", hits);
+			stat_info("regions", search.regions());
+			if(!write_stats(stats_path))
+				std::cerr << "Can't write " << stats_path << "\n";
+		}
+		return 0;
 	}
 
-	std::vector<int> interfere_x(int index) const{
-
-		//binary search for range of cubes_ interfered by x coordinate with cubes_[index]
-		auto x_range_pair = std::equal_range(x_sorted_cubes.begin(), x_sorted_cubes.end(), index, [this](int a1, int a2) -> bool { return  cubes_[a1].x2 < cubes_[a2].x1;}); 
-
-		std::vector<int> x_interfered = {x_range_pair.first, x_range_pair.second};		
-
-		return x_interfered;
+	stat_phase_t load{"load"};
+	mapped_file_t input;                 // text or binary (tri_io.h) triangles from file or stdin
+	if(!input.open(input_path)){
+		std::cout << "Invalid input!\n";
+		return 0;
 	}
 
-	cube_t<T> operator[](int idx) const{
-		return cubes_[idx];
+	std::vector<float> storage;
+	const float* coords = nullptr;       // 9 floats per triangle, straight from the mapping for binary float input
+	size_t count = 0;
+	if(!load_triangles(input, storage, coords, count) || count > (size_t)INT_MAX){   // ids are int
+		std::cout << "Invalid input!\n";
+		return 0;
 	}
 
-};
+	int tri_n = count;
+	triangle_soup<float> triangles{coords, count};
+	std::vector<float>().swap(storage);
+	load.stop();
 
-
-int main(){
-	int tri_n;
-	std::cin >> tri_n;
-	if(!std::cin.good()){
-		std::cout << "Invalid input!\n";
-		return 0;
+	std::vector<int> order;              // input id of every soup index when the soup is reordered, empty - the index itself
+	if(reorder != REORDER_NONE){
+		stat_phase_t sort{"reorder"};
+		order = spatial_order(triangles, reorder);
+		triangles.permute(order);
 	}
 
+	if(narrow == NARROW_PLANES){         // after the reordering, nothing to move
+		stat_phase_t planes{"planes"};
+		triangles.cache_planes();
+	}
 
-	std::vector<polygon_t<float>> triangles;
+	if(tri_stats_enabled)
+		for(int i = 0; i < tri_n; i++)
+			if(triangles.triangle(i).degenerate())
+				stat_add(STAT_DEGENERATE);
 
 
 #ifndef WITH_SORTED
 
 	std::vector<cube_t<float>> cubes;
 
-#endif
-
-	for(int i = 0; i < tri_n; i++){
-		polygon_t<float> tri;
-		for(int j = 0; j < 3; j++){
-			float a, b, c;
-			std::cin >> a >> b >> c;
-			if(!std::cin.good()){
-				std::cout << "Invalid input!\n";
-				return 0;
-			}
-			tri.add(point_t<float>{a, b, c});
-		}
-		triangles.insert(triangles.end(), tri);
-
-#ifndef WITH_SORTED
-
-		cubes.insert(cubes.end(), {triangles[i], 0.0});
+	for(int i = 0; i < tri_n; i++)
+		cubes.insert(cubes.end(), {triangles, i, 0.0});
 
 #endif
 
+	out_file_t output{format};
+	if(!output.open(output_path)){
+		std::cout << "Can't open " << output_path << "\n";
+		return 0;
 	}
 
-#ifdef WITH_SORTED
-
-	sorted_cubes<float> s_cubes{triangles};
-
-#endif
-
-	bool* intersected = new bool[tri_n];
-
-	for(int i = 0; i < tri_n; i++)
-		intersected[i] = false;
-
-
-#ifdef TRI_LOGGING
-
-	std::string algo_name;
-
-
-#ifdef WITH_SORTED
-
-	algo_name = "using sorted cubes vector";
-
-#else
-
-	algo_name = "using unsorted vector";
-
-
-#endif
-
-	unsigned long long delta_time = time(nullptr);
-	std::cout << "Start checking " << algo_name << "..." << std::endl;
+	intersect_flags_t intersected{(size_t)tri_n};
+	bool sharded = shards > 1;
+	size_t shard_copies = 0;
+	unsigned shard_threads = 0;
+	if(sharded){ // the shards are forked here, before the coordinator starts any thread
+		stat_phase_t search{"search"};
+		sharded_search split{triangles, shards};
+		shard_copies = split.copies();
+		shard_threads = split.threads_per_shard(threads);
+		bool done = split.run(triangles, threads, narrow, tri_batch_kernel(simd), intersected, output, all_pairs, order.empty() ? nullptr : order.data(),
+			[&](triangle_soup<float> const &part, intersect_flags_t const &flags, thread_pool_t &pool, std::vector<pair_checker_t> &checkers){
+				search_broad(broad, cell_size, part, flags, pool, checkers);
+			});
+		if(!done){
+			output.close();
+			std::cerr << "A shard failed\n";
+			return 0;
+		}
+	}
+	thread_pool_t pool{sharded ? 1 : threads};
+	std::deque<out_buffer_t> pair_buffers;  // one per worker in all pairs mode
+	std::vector<pair_checker_t> checkers;   // one per worker
+	for(unsigned w = 0; w < pool.size(); w++){
+		if(all_pairs)
+			pair_buffers.emplace_back(output);
+		checkers.push_back({triangles, narrow, tri_batch_kernel(simd), intersected, all_pairs ? &pair_buffers.back() : nullptr});
+		if(!order.empty())
+			checkers.back().set_ids(order.data());
+	}
 
-#endif
 
 //												average concentration in whole volume		volume of layer that conatains cubes with the intersected x coord
 //		SORTED CUBES ALGORYTHM									                  |                |
@@ -209,40 +415,8 @@ int main(){
 	//                  MEMORY COMPLEXITY: O(N) 
 
 
-#ifdef TRI_LOGGING
-
-	
-	int check_point = 0;
-	float check_step = 0.02;
-
-#endif
-
-	for(int i = 0; i < tri_n; i++){ // N
-
-#ifdef TRI_LOGGING
-
-		if(i >= check_point){
-			std::cout << (int)((float)check_point/(float)tri_n * 100.0) << "% done..." << std::endl;
-			check_point += tri_n * check_step;
-		}
-
-#endif
-
-		if(intersected[i])
-			continue;
-		std::vector<int> prob_intersect = s_cubes.interfere_x(i); // logN
-
-		for(int j = 0; j < prob_intersect.size(); j++){ // M
-			int idx_cube = prob_intersect[j];
-			if(i == idx_cube || !(s_cubes[i].z_interfere(s_cubes[idx_cube]) && s_cubes[i].y_interfere(s_cubes[idx_cube])))
-				continue;
-			if(triangles[i].intersect(triangles[idx_cube])){
-				intersected[i] = true;
-				intersected[idx_cube] = true;
-				break;
-			}
-		}
-	}
+	if(!sharded)
+		search_broad(broad, cell_size, triangles, intersected, pool, checkers);
 
 //
 //           UNSORTED ONE BY ONE CHECKING
@@ -252,41 +426,62 @@ int main(){
 // 						MEMORY COMPLXTY: O(N)
 //
 
+	stat_phase_t search{"search"};
 	for(int i = 0; i < tri_n; i++){
-		if(intersected[i])
+		if(!all_pairs && intersected[i])
 			continue;
 
-		for(int j = 0; j < tri_n; j++){
+		for(int j = all_pairs ? i + 1 : 0; j < tri_n; j++){
 			if(i == j  || !cubes[i].interfare(cubes[j]))
 				continue;
-			if(triangles[i].intersect(triangles[j])){
-				intersected[i] = true;
-				intersected[j] = true;
+			checkers[0](i, j);
+			if(!all_pairs && intersected[i])
 				break;
-			}
 		}
+		checkers[0].flush();
 	}
+	search.stop();
 
 
 #endif
 
-#ifdef TRI_LOGGING
-
-	delta_time = time(nullptr) - delta_time;
-	std::cout << "Time elapsed:" << delta_time << std::endl; 
-#endif
-
-
-#ifndef TRI_LOGGING
-
-	for (int i = 0; i < tri_n; i++)
-		if(intersected[i]){
-		std::cout << i << std::endl;
+	stat_phase_t write{"output"};
+	size_t hits = 0;
+	{
+		std::vector<char> hit(tri_n);       // by input id
+		for(int i = 0; i < tri_n; i++)
+			hit[order.empty() ? i : order[i]] = intersected[i];
+		out_buffer_t ids{output};
+		for (int i = 0; i < tri_n; i++)
+			if(hit[i]){
+				hits++;
+				if(!all_pairs)
+					ids.put(i);
+			}
 	}
 
-#endif
-
-	delete[] intersected;
+	pair_buffers.clear();
+	output.close();
+	write.stop();
+
+	if(stats_path != nullptr){
+		const char* broad_names[] = {"sorted", "sap", "grid", "bvh", "buckets"};
+		const char* narrow_names[] = {"angle", "planes", "batch", "exact"};
+		stat_info("broad", broad_names[broad]);
+		const char* reorder_names[] = {"none", "morton", "hilbert"};
+		stat_info("narrow", narrow_names[narrow]);
+		stat_info("reorder", reorder_names[reorder]);
+		stat_info("simd", tri_batch_kernel_name(tri_batch_kernel(simd)));
+		stat_info("threads", sharded ? shard_threads : pool.size());   // per shard
+		stat_info("triangles", tri_n);
+		stat_info("intersected", hits);
+		if(sharded){
+			stat_info("shards", shards);
+			stat_info("shard_triangles", shard_copies);
+		}
+		if(!write_stats(stats_path))
+			std::cerr << "Can't write " << stats_path << "\n";
+	}
 
 
 	return 0;
@@ -0,0 +1,205 @@
+#pragma once
+#include "lingeo3D.h"
+#include <vector>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <algorithm>
+
+namespace lingeo3D{
+
+	enum narrow_t {NARROW_ANGLE, NARROW_PLANES, NARROW_BATCH, NARROW_EXACT}; // triangle_t::intersect, triangle_t::intersect_by_planes, the same in SIMD lanes (tri_batch.h) or triangle_t::intersect_exact
+
+	template<typename T, size_t Align = 64>
+	struct aligned_allocator_t{ // keeps every coordinate array on its own cache line boundary
+		typedef T value_type;
+
+		template<typename U>
+		struct rebind{ typedef aligned_allocator_t<U, Align> other; };
+
+		aligned_allocator_t(){}
+		template<typename U>
+		aligned_allocator_t(aligned_allocator_t<U, Align> const &){}
+
+		T* allocate(size_t n){
+			size_t bytes = (n * sizeof(T) + Align - 1) / Align * Align;
+			void* ptr = std::aligned_alloc(Align, bytes);
+			if(ptr == nullptr)
+				throw std::bad_alloc();
+			return static_cast<T*>(ptr);
+		}
+
+		void deallocate(T* ptr, size_t){
+			std::free(ptr);
+		}
+
+		template<typename U>
+		bool operator==(aligned_allocator_t<U, Align> const &) const{ return true; }
+		template<typename U>
+		bool operator!=(aligned_allocator_t<U, Align> const &) const{ return false; }
+	};
+
+	template<typename T>
+	using aligned_vector = std::vector<T, aligned_allocator_t<T>>;
+
+
+/*
+	              TRIANGLE SOUP
+	  structure-of-arrays storage of triangles: x[k][i], y[k][i], z[k][i] hold the k-th vertex of the i-th triangle,
+	  the tight axis aligned bounding box of every triangle is kept in six more arrays next to them
+	  cache_planes() adds a side table of per triangle plane data (tri_plane_t, one cache line each), from then on
+	  NARROW_PLANES reads it instead of recomputing normals for every pair and set() keeps it up to date
+	  permute() reorders all the arrays at once (spatial_order.h), boxes and planes are moved, not recomputed
+
+*/
+
+template<typename T>
+	class triangle_soup{
+
+		size_t size_ = 0;
+		aligned_vector<T> x_[3], y_[3], z_[3];
+		aligned_vector<T> min_x_, min_y_, min_z_, max_x_, max_y_, max_z_;
+		bool planes_cached_ = false;
+		aligned_vector<tri_plane_t<T>> planes_;
+
+		void fit_box(size_t i){
+			min_x_[i] = std::min(x_[0][i], std::min(x_[1][i], x_[2][i]));
+			min_y_[i] = std::min(y_[0][i], std::min(y_[1][i], y_[2][i]));
+			min_z_[i] = std::min(z_[0][i], std::min(z_[1][i], z_[2][i]));
+			max_x_[i] = std::max(x_[0][i], std::max(x_[1][i], x_[2][i]));
+			max_y_[i] = std::max(y_[0][i], std::max(y_[1][i], y_[2][i]));
+			max_z_[i] = std::max(z_[0][i], std::max(z_[1][i], z_[2][i]));
+		}
+
+		void fit_planes(size_t i){
+			planes_[i] = tri_plane_t<T>{triangle(i)};
+		}
+
+	public:
+
+		triangle_soup(){}
+
+		triangle_soup(const T* coords, size_t count){          // 9 coordinates per triangle: x y z of 1st, 2nd and 3rd vertex
+			assign(coords, count);
+		}
+
+		void resize(size_t count){
+			size_ = count;
+			for(int k = 0; k < 3; k++){
+				x_[k].resize(count);
+				y_[k].resize(count);
+				z_[k].resize(count);
+			}
+			min_x_.resize(count); min_y_.resize(count); min_z_.resize(count);
+			max_x_.resize(count); max_y_.resize(count); max_z_.resize(count);
+			if(planes_cached_)
+				planes_.resize(count);
+		}
+
+		void assign(const T* coords, size_t count){
+			resize(count);
+			for(size_t i = 0; i < count; i++){
+				const T* tri = coords + i * 9;
+				for(int k = 0; k < 3; k++){
+					x_[k][i] = tri[k * 3];
+					y_[k][i] = tri[k * 3 + 1];
+					z_[k][i] = tri[k * 3 + 2];
+				}
+				fit_box(i);
+				if(planes_cached_)
+					fit_planes(i);
+			}
+		}
+
+		void set(size_t i, point_t<T> const &a, point_t<T> const &b, point_t<T> const &c){
+			point_t<T> const* verts[3] = {&a, &b, &c};
+			for(int k = 0; k < 3; k++){
+				x_[k][i] = verts[k]->x_;
+				y_[k][i] = verts[k]->y_;
+				z_[k][i] = verts[k]->z_;
+			}
+			fit_box(i);
+			if(planes_cached_)
+				fit_planes(i);
+		}
+
+		void set(size_t i, triangle_t<T> const &tri){
+			set(i, tri[0], tri[1], tri[2]);
+		}
+
+		void push_back(point_t<T> const &a, point_t<T> const &b, point_t<T> const &c){
+			resize(size_ + 1);
+			set(size_ - 1, a, b, c);
+		}
+
+		void permute(std::vector<int> const &order){ // the order[k]-th triangle becomes the k-th one, order is a permutation of the indices
+			auto gather = [&](auto &array){
+				typename std::remove_reference<decltype(array)>::type moved(size_);
+				for(size_t k = 0; k < size_; k++)
+					moved[k] = array[order[k]];
+				array.swap(moved);
+			};
+			for(int k = 0; k < 3; k++){
+				gather(x_[k]);
+				gather(y_[k]);
+				gather(z_[k]);
+			}
+			gather(min_x_); gather(min_y_); gather(min_z_);
+			gather(max_x_); gather(max_y_); gather(max_z_);
+			if(planes_cached_)
+				gather(planes_);
+		}
+
+		size_t size() const{ return size_; }
+
+		void cache_planes(){
+			if(planes_cached_)
+				return;
+			planes_cached_ = true;
+			planes_.resize(size_);
+			for(size_t i = 0; i < size_; i++)
+				fit_planes(i);
+		}
+
+		bool planes_cached() const{ return planes_cached_; }
+		tri_plane_t<T> const &plane(size_t i) const{ return planes_[i]; }
+
+		point_t<T> vertex(size_t i, int k) const{
+			return point_t<T>{x_[k][i], y_[k][i], z_[k][i]};
+		}
+
+		triangle_t<T> triangle(size_t i) const{
+			return triangle_t<T>{vertex(i, 0), vertex(i, 1), vertex(i, 2)};
+		}
+
+		polygon_t<T> polygon(size_t i) const{
+			return triangle(i);
+		}
+
+		const T* x(int k) const{ return x_[k].data(); }
+		const T* y(int k) const{ return y_[k].data(); }
+		const T* z(int k) const{ return z_[k].data(); }
+
+		T min_x(size_t i) const{ return min_x_[i]; }
+		T min_y(size_t i) const{ return min_y_[i]; }
+		T min_z(size_t i) const{ return min_z_[i]; }
+		T max_x(size_t i) const{ return max_x_[i]; }
+		T max_y(size_t i) const{ return max_y_[i]; }
+		T max_z(size_t i) const{ return max_z_[i]; }
+
+		bool intersect(size_t i, triangle_soup<T> const &other, size_t j, narrow_t method = NARROW_ANGLE) const{ // i-th triangle here against the j-th one of other
+			if(method == NARROW_EXACT)
+				return triangle(i).intersect_exact(other.triangle(j));
+			if(method != NARROW_ANGLE && planes_cached_ && other.planes_cached_)
+				return planes_intersect(planes_[i], other.planes_[j]);
+			if(method != NARROW_ANGLE)
+				return triangle(i).intersect_by_planes(other.triangle(j));
+			return triangle(i).intersect(other.triangle(j));
+		}
+
+		bool intersect(size_t i, size_t j, narrow_t method = NARROW_ANGLE) const{ // same check as polygon_t::intersect, without building polygons
+			return intersect(i, *this, j, method);
+		}
+	};
+
+};
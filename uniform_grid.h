@@ -0,0 +1,202 @@
+#pragma once
+#include "lingeo3D.h"
+#include "triangle_soup.h"
+#include "sorted_cubes.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+namespace lingeo3D{
+
+/*
+	              UNIFORM GRID
+	  space is cut into cubic cells, every triangle is binned into the cells its box (grown by flt_tolerance) touches
+	  and candidates only come from triangles sharing a cell, so the cost does not depend on how crowded an x slab is
+	  occupied cells are found through a hash table of 2 * (number of entries) buckets: a bucket may hold several cells,
+	  entries keep their cell id so only triangles of the same cell are paired
+	  a pair sharing several cells is reported only by the cell holding the lower corner of the two boxes' overlap
+	  triangles touching more than max_cells_ cells would flood the table, they are checked against all boxes instead
+
+*/
+
+template<typename T>
+	class uniform_grid{
+
+		std::vector<cube_t<T>> cubes_;    // tight boxes by triangle index
+		T cell_ = 1.0;
+		T org_x_ = 0.0, org_y_ = 0.0, org_z_ = 0.0;
+		int64_t dim_x_ = 1, dim_y_ = 1, dim_z_ = 1;
+
+		std::vector<size_t> bucket_start_; // entries of bucket b are [bucket_start_[b], bucket_start_[b + 1])
+		std::vector<int> members_;         // triangle of every entry
+		std::vector<uint64_t> member_cells_; // cell of every entry
+		std::vector<int> big_;             // triangles spanning too many cells
+
+		static const int max_cells_ = 512;
+		static const int buckets_per_unit_ = 4096;
+
+		int64_t cell_coord(T val, T org, int64_t dim) const{
+			T c = std::floor((val - org) / cell_);
+			if(!(c > 0))                                    // NaN lands in the first cell too
+				return 0;
+			return (c >= dim - 1) ? dim - 1 : (int64_t)c;
+		}
+
+		uint64_t cell_id(int64_t cx, int64_t cy, int64_t cz) const{
+			return ((uint64_t)cx * dim_y_ + cy) * dim_z_ + cz;
+		}
+
+		static uint64_t bucket_hash(uint64_t id){ // splitmix64 finalizer
+			id ^= id >> 30; id *= 0xbf58476d1ce4e5b9ULL;
+			id ^= id >> 27; id *= 0x94d049bb133111ebULL;
+			return id ^ (id >> 31);
+		}
+
+		void cell_range(int i, int64_t lo[3], int64_t hi[3]) const{
+			cube_t<T> const &c = cubes_[i];
+			lo[0] = cell_coord(c.min_x() - flt_tolerance, org_x_, dim_x_); hi[0] = cell_coord(c.max_x() + flt_tolerance, org_x_, dim_x_);
+			lo[1] = cell_coord(c.min_y() - flt_tolerance, org_y_, dim_y_); hi[1] = cell_coord(c.max_y() + flt_tolerance, org_y_, dim_y_);
+			lo[2] = cell_coord(c.min_z() - flt_tolerance, org_z_, dim_z_); hi[2] = cell_coord(c.max_z() + flt_tolerance, org_z_, dim_z_);
+		}
+
+		uint64_t owner_cell(cube_t<T> const &a, cube_t<T> const &b) const{ // cell of the lower corner of the overlap of a and b
+			return cell_id(cell_coord(std::max(a.min_x(), b.min_x()), org_x_, dim_x_),
+			               cell_coord(std::max(a.min_y(), b.min_y()), org_y_, dim_y_),
+			               cell_coord(std::max(a.min_z(), b.min_z()), org_z_, dim_z_));
+		}
+
+	public:
+
+		uniform_grid(triangle_soup<T> const &soup, T cell_size = 0.0){ // cell_size 0 - picked from the triangle sizes
+			int n = soup.size();
+			cubes_.reserve(n);
+			for(int i = 0; i < n; i++)
+				cubes_.insert(cubes_.end(), {soup, i});
+			if(n == 0){
+				bucket_start_.assign(2, 0);
+				return;
+			}
+
+			T max_x = cubes_[0].max_x(), max_y = cubes_[0].max_y(), max_z = cubes_[0].max_z();
+			org_x_ = cubes_[0].min_x(); org_y_ = cubes_[0].min_y(); org_z_ = cubes_[0].min_z();
+			std::vector<T> sizes(n);
+			for(int i = 0; i < n; i++){
+				cube_t<T> const &c = cubes_[i];
+				org_x_ = std::min(org_x_, c.min_x()); org_y_ = std::min(org_y_, c.min_y()); org_z_ = std::min(org_z_, c.min_z());
+				max_x = std::max(max_x, c.max_x()); max_y = std::max(max_y, c.max_y()); max_z = std::max(max_z, c.max_z());
+				sizes[i] = std::max(c.max_x() - c.min_x(), std::max(c.max_y() - c.min_y(), c.max_z() - c.min_z()));
+			}
+			org_x_ -= flt_tolerance; org_y_ -= flt_tolerance; org_z_ -= flt_tolerance;
+
+			// twice the median triangle: a typical triangle touches up to 8 cells and a cell holds a handful of triangles
+			T extent = std::max(max_x - org_x_, std::max(max_y - org_y_, max_z - org_z_));
+			if(cell_size <= 0.0){
+				std::nth_element(sizes.begin(), sizes.begin() + n / 2, sizes.end());
+				cell_size = 2 * sizes[n / 2];
+			}
+			cell_ = std::max(cell_size, std::max(extent / (1 << 20), (T)flt_tolerance));   // cell coordinates fit 21 bits each
+			dim_x_ = (int64_t)((max_x - org_x_) / cell_) + 1;
+			dim_y_ = (int64_t)((max_y - org_y_) / cell_) + 1;
+			dim_z_ = (int64_t)((max_z - org_z_) / cell_) + 1;
+
+			// counting sort of (cell, triangle) entries by bucket
+			std::vector<int> spans(n);
+			size_t entries = 0;
+			for(int i = 0; i < n; i++){
+				int64_t lo[3], hi[3];
+				cell_range(i, lo, hi);
+				int64_t span = (hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) * (hi[2] - lo[2] + 1);
+				spans[i] = (span > max_cells_) ? 0 : span;
+				if(spans[i] == 0)
+					big_.push_back(i);
+				entries += spans[i];
+			}
+
+			size_t buckets = 1;
+			while(buckets < 2 * entries)
+				buckets <<= 1;
+			bucket_start_.assign(buckets + 1, 0);
+			members_.resize(entries);
+			member_cells_.resize(entries);
+
+			auto for_each_cell = [this](int i, auto &&visit){
+				int64_t lo[3], hi[3];
+				cell_range(i, lo, hi);
+				for(int64_t cx = lo[0]; cx <= hi[0]; cx++)
+					for(int64_t cy = lo[1]; cy <= hi[1]; cy++)
+						for(int64_t cz = lo[2]; cz <= hi[2]; cz++)
+							visit(cell_id(cx, cy, cz));
+			};
+
+			for(int i = 0; i < n; i++)
+				if(spans[i] != 0)
+					for_each_cell(i, [&](uint64_t id){ bucket_start_[(bucket_hash(id) & (buckets - 1)) + 1]++; });
+			for(size_t b = 0; b < buckets; b++)
+				bucket_start_[b + 1] += bucket_start_[b];
+			std::vector<size_t> fill(bucket_start_.begin(), bucket_start_.end() - 1);
+			for(int i = 0; i < n; i++)
+				if(spans[i] != 0)
+					for_each_cell(i, [&](uint64_t id){
+						size_t pos = fill[bucket_hash(id) & (buckets - 1)]++;
+						members_[pos] = i;
+						member_cells_[pos] = id;
+					});
+		}
+
+		T cell_size() const{ return cell_; }
+
+		size_t work_size() const{ // blocks of buckets, then one unit per oversized triangle
+			return (bucket_start_.size() - 1 + buckets_per_unit_ - 1) / buckets_per_unit_ + big_.size();
+		}
+
+		template<typename Fn>
+		void for_each_pair(size_t begin, size_t end, Fn &fn) const{ // fn(i, j) for every candidate pair owned by units [begin, end), pairs sharing i come in a row
+			size_t buckets = bucket_start_.size() - 1;
+			size_t bucket_units = (buckets + buckets_per_unit_ - 1) / buckets_per_unit_;
+			for(size_t unit = begin; unit < end; unit++){
+				if(unit >= bucket_units){
+					pairs_of_big(unit - bucket_units, fn);
+					continue;
+				}
+				size_t last_bucket = std::min(buckets, (unit + 1) * buckets_per_unit_);
+				for(size_t b = unit * buckets_per_unit_; b < last_bucket; b++){
+					size_t first = bucket_start_[b], last = bucket_start_[b + 1];
+					for(size_t p = first; p < last; p++){
+						cube_t<T> const &cube = cubes_[members_[p]];
+						for(size_t q = p + 1; q < last; q++){
+							if(member_cells_[q] != member_cells_[p])
+								continue;
+							cube_t<T> const &other = cubes_[members_[q]];
+							if(!cube.interfare(other) || owner_cell(cube, other) != member_cells_[p])
+								continue;
+							fn(members_[p], members_[q]);
+						}
+					}
+				}
+			}
+		}
+
+		template<typename Fn>
+		void for_each_pair(Fn &fn) const{
+			for_each_pair(0, work_size(), fn);
+		}
+
+	private:
+
+		template<typename Fn>
+		void pairs_of_big(size_t k, Fn &fn) const{ // oversized triangle against every box, pairs of two oversized ones go to the first of them
+			int i = big_[k];
+			cube_t<T> const &cube = cubes_[i];
+			for(int j = 0; j < cubes_.size(); j++){
+				if(j == i || !cube.interfare(cubes_[j]))
+					continue;
+				auto pos = std::lower_bound(big_.begin(), big_.end(), j);
+				if(pos != big_.end() && *pos == j && (size_t)(pos - big_.begin()) < k)
+					continue;
+				fn(i, j);
+			}
+		}
+	};
+
+};